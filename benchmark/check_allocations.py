@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Check the allocations meta needs per package while loading.
+
+Two synthetic trees that differ only in their number of packages are generated
+with generate_tree.py, and "meta stats --alloc-stats" runs in both of them.
+The difference of their "meta (loaded)" allocation counts, divided by the
+difference of their sizes, is what loading costs per package. The check fails
+if that exceeds the budget, or what --baseline, another meta binary, needs on
+the same trees. A json array or object of every package that is copied again
+instead of being used in place shows up as one or more allocations per package.
+
+The counts depend on the length of the paths in the tree and on the regex
+implementation of the C library, so the trees are always written to
+/tmp/meta-allocations-XXXXXXXX. Compare two builds with --baseline for exact
+numbers, the budget leaves room for other C libraries.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+LOADED = re.compile(r"^meta \(loaded\): (\d+) allocations")
+
+
+def loaded_allocations(meta, tree):
+    # meta stats never hands itself to a server and the tree has no gendata directory to
+    # write caches to, so every run loads and expands all globs from scratch
+    command = [meta, "stats", "--no-glob-cache", "--alloc-stats"]
+    process = subprocess.run(command, cwd=tree, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                             universal_newlines=True)
+    if process.returncode != 0:
+        sys.exit("%s failed in %s:\n%s" % (" ".join(command), tree, process.stderr))
+    for line in process.stderr.splitlines():
+        match = LOADED.match(line)
+        if match:
+            return int(match.group(1))
+    sys.exit("%s printed no allocation statistics in %s" % (" ".join(command), tree))
+
+
+def per_package(meta, trees):
+    (small, small_tree), (large, large_tree) = trees
+    counts = [loaded_allocations(meta, small_tree), loaded_allocations(meta, large_tree)]
+    result = (counts[1] - counts[0]) / float(large - small)
+    print("%-40s %9d %9d %12.1f" % (meta, counts[0], counts[1], result))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--meta", default=os.path.join(os.path.dirname(SCRIPT_DIR), "meta"),
+                        help="meta binary to check (default: the one in the repository root)")
+    parser.add_argument("--baseline", help="fail if --meta needs more allocations per package than this meta binary")
+    parser.add_argument("--packages", type=int, nargs=2, default=[100, 300], metavar=("SMALL", "LARGE"),
+                        help="sizes of the two trees (default: 100 300)")
+    parser.add_argument("--max-per-package", type=float, default=2110,
+                        help="allocations one more package may cost while loading (default: 2110)")
+    args = parser.parse_args()
+    binaries = [os.path.abspath(args.meta)] + ([os.path.abspath(args.baseline)] if args.baseline else [])
+    for meta in binaries:
+        if not os.access(meta, os.X_OK):
+            sys.exit("meta binary not found: %s" % meta)
+    small, large = args.packages
+    if small < 1 or large <= small:
+        parser.error("the second size must be larger than the first one")
+
+    work_directory = tempfile.mkdtemp(prefix="meta-allocations-", dir="/tmp")
+    try:
+        trees = []
+        for packages in (small, large):
+            tree = os.path.join(work_directory, "tree-%d" % packages)
+            subprocess.check_call([sys.executable, os.path.join(SCRIPT_DIR, "generate_tree.py"), tree,
+                                   "--packages", str(packages)], stdout=subprocess.DEVNULL)
+            trees.append((packages, tree))
+
+        print("%-40s %9s %9s %12s" % ("meta", small, large, "per package"))
+        result = per_package(binaries[0], trees)
+        baseline = per_package(binaries[1], trees) if args.baseline else None
+    finally:
+        shutil.rmtree(work_directory)
+
+    if result > args.max_per_package:
+        print("Loading allocates %.1f times per package, the budget is %.1f" % (result, args.max_per_package),
+              file=sys.stderr)
+        return 1
+    if baseline is not None and result > baseline:
+        print("Loading allocates %.1f times per package, the baseline only %.1f" % (result, baseline),
+              file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
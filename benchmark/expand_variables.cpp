@@ -0,0 +1,277 @@
+// Compares the variable expander of StringUtils with the regex based substitution it
+// replaced. Both run the substitutions of FileProvider::replace_path_variables and
+// CMakeGenerator::make_path_with_cmake_variables on the paths of a meta tree, and the
+// results are checked to be equal before anything is timed.
+//
+// The path variables are expanded in the source, include, exclude, precompiled header,
+// deploy and test resource values of all meta json files below the tree. The CMake
+// variables are expanded in the resulting absolute paths and in their directories, which
+// meta watches, after the root prefix is replaced by ${PROJECT_ROOT_DIR} like meta does.
+// The bundled serenity tree has no sources, so glob patterns stand for the files they match.
+//
+// usage: benchmark/expand_variables [tree] [iterations]
+
+#include "../src/StringUtils.h"
+#include <AK/FileSystemPath.h>
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/QuickSort.h>
+#include <AK/StringBuilder.h>
+#include <AK/Vector.h>
+#include <dirent.h>
+#include <limits.h>
+#include <regex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// the implementation before the expander, one regex per variable and call
+static String regex_replace(const String& haystack, const String& needle, const String& replacement)
+{
+    std::string hs(haystack.characters(), haystack.length());
+    std::string replaced = std::regex_replace(hs, std::regex(needle.characters()), replacement.characters());
+    return replaced.c_str();
+}
+
+static String regex_replace_variables(const String& haystack, const String& varname, const String& replacement)
+{
+    StringBuilder sb;
+    sb.append("\\$\\{");
+    sb.append(varname);
+    sb.append("\\}");
+    return regex_replace(haystack, sb.build(), replacement);
+}
+
+struct Variable {
+    String name;
+    String value;
+};
+
+static String old_expand(const String& path, const Vector<Variable>& variables)
+{
+    if (!potentially_contains_variable(path))
+        return path;
+    String result = path;
+    for (auto& variable : variables)
+        result = regex_replace_variables(result, variable.name, variable.value);
+    return result;
+}
+
+static HashMap<String, String> make_table(const Vector<Variable>& variables)
+{
+    HashMap<String, String> table;
+    for (auto& variable : variables)
+        table.set(variable.name, variable.value);
+    return table;
+}
+
+static String new_expand(const String& path, const HashMap<String, String>& table)
+{
+    if (!potentially_contains_variable(path))
+        return path;
+    return expand_variables(path, table);
+}
+
+static bool is_path_key(const String& key)
+{
+    static const char* s_path_keys[] = { "source", "include", "exclude", "exclude_from_package_source", "precompiled_headers", "additional_resource" };
+    for (auto* path_key : s_path_keys) {
+        if (key == path_key)
+            return true;
+    }
+    return false;
+}
+
+struct JsonPath {
+    String path;
+    String directory;
+};
+
+static void collect_json_paths(const JsonValue& value, bool is_path, const String& directory, Vector<JsonPath>& paths)
+{
+    if (value.is_string()) {
+        if (is_path)
+            paths.append({ value.as_string(), directory });
+    } else if (value.is_array()) {
+        for (auto& element : value.as_array().values())
+            collect_json_paths(element, is_path, directory, paths);
+    } else if (value.is_object()) {
+        value.as_object().for_each_member([&](auto& key, auto& member) {
+            collect_json_paths(member, is_path_key(key), directory, paths);
+        });
+    }
+}
+
+static String read_file(const String& filename)
+{
+    FILE* file = fopen(filename.characters(), "r");
+    if (!file)
+        return {};
+    StringBuilder builder;
+    char buffer[4096];
+    size_t nread;
+    while ((nread = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        builder.append(StringView(buffer, nread));
+    fclose(file);
+    return builder.build();
+}
+
+static void collect_meta_json_paths(const String& directory, Vector<JsonPath>& paths)
+{
+    DIR* dir = opendir(directory.characters());
+    if (!dir)
+        return;
+    Vector<String> names;
+    while (auto* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+            names.append(entry->d_name);
+    }
+    closedir(dir);
+    // readdir order differs between file systems, keep the runs comparable
+    quick_sort(names.begin(), names.end(), [](auto& a, auto& b) { return strcmp(a.characters(), b.characters()) < 0; });
+
+    for (auto& name : names) {
+        StringBuilder builder;
+        builder.append(directory);
+        builder.append('/');
+        builder.append(name);
+        auto path = builder.build();
+
+        struct stat st;
+        if (stat(path.characters(), &st) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            collect_meta_json_paths(path, paths);
+        else if (path.ends_with(".m.json"))
+            collect_json_paths(JsonValue::from_string(read_file(path)), false, directory, paths);
+    }
+}
+
+// the steps of make_path_with_cmake_variables before the expander
+static String with_root_variable(const String& path, const String& root)
+{
+    if (!path.starts_with(root) || (path.length() > root.length() && path[root.length()] != '/'))
+        return path;
+    StringBuilder builder;
+    builder.append("${PROJECT_ROOT_DIR}");
+    builder.append(path.substring_view(root.length(), path.length() - root.length()));
+    return builder.build();
+}
+
+static String absolute_path(const String& path, const String& directory)
+{
+    if (path.starts_with("/"))
+        return path;
+    StringBuilder builder;
+    builder.append(directory);
+    builder.append('/');
+    builder.append(path);
+    return builder.build();
+}
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+template<typename Callback>
+static double time_per_call_ns(const Vector<String>& paths, int iterations, Callback callback)
+{
+    size_t total_length = 0;
+    double start = now_ms();
+    for (int i = 0; i < iterations; ++i) {
+        for (auto& path : paths)
+            total_length += callback(path).length();
+    }
+    double elapsed = now_ms() - start;
+    // keeps the results alive, so the calls cannot be optimized away
+    if (total_length == 0)
+        fprintf(stderr, "no output\n");
+    return elapsed * 1000000.0 / ((double)iterations * paths.size());
+}
+
+int main(int argc, char** argv)
+{
+    const char* tree = argc > 1 ? argv[1] : "serenity";
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    char root_buffer[PATH_MAX];
+    if (iterations <= 0 || !realpath(tree, root_buffer)) {
+        fprintf(stderr, "usage: %s [tree] [iterations]\n", argv[0]);
+        return 1;
+    }
+    String root = root_buffer;
+
+    Vector<JsonPath> json_paths;
+    collect_meta_json_paths(root, json_paths);
+    if (json_paths.is_empty()) {
+        fprintf(stderr, "No paths in the meta json files below %s\n", root.characters());
+        return 1;
+    }
+
+    StringBuilder gendata;
+    gendata.append(root);
+    gendata.append("/build-gen");
+    StringBuilder package_gendata;
+    package_gendata.append(gendata.to_string());
+    package_gendata.append("/Package/Target");
+
+    Vector<Variable> path_variables;
+    path_variables.append({ "root", root });
+    path_variables.append({ "gendata", gendata.to_string() });
+    path_variables.append({ "package_gendata", package_gendata.to_string() });
+
+    Vector<Variable> cmake_variables;
+    cmake_variables.append({ "root", "${PROJECT_ROOT_DIR}" });
+    cmake_variables.append({ "package_gendata", "${CMAKE_CURRENT_LIST_DIR}/${META_BUILD_IMAGE}" });
+    cmake_variables.append({ "host_sysroot", "${CMAKE_SYSROOT}" });
+    cmake_variables.append({ "image", "${META_BUILD_IMAGE}" });
+
+    auto path_table = make_table(path_variables);
+    auto cmake_table = make_table(cmake_variables);
+
+    Vector<String> paths;
+    Vector<String> cmake_paths;
+    for (auto& json_path : json_paths) {
+        auto old_path = old_expand(json_path.path, path_variables);
+        auto new_path = new_expand(json_path.path, path_table);
+        if (old_path != new_path) {
+            fprintf(stderr, "Results differ for %s: %s / %s\n", json_path.path.characters(), old_path.characters(), new_path.characters());
+            return 1;
+        }
+        paths.append(json_path.path);
+        auto full_path = absolute_path(new_path, json_path.directory);
+        cmake_paths.append(with_root_variable(full_path, root));
+        cmake_paths.append(with_root_variable(FileSystemPath(full_path).dirname(), root));
+    }
+
+    for (auto& path : cmake_paths) {
+        auto old_cmake = old_expand(path, cmake_variables);
+        auto new_cmake = new_expand(path, cmake_table);
+        if (old_cmake != new_cmake) {
+            fprintf(stderr, "Results differ for %s: %s / %s\n", path.characters(), old_cmake.characters(), new_cmake.characters());
+            return 1;
+        }
+    }
+
+    printf("%zu paths from the meta json files below %s, %zu paths and directories for CMake\n",
+        paths.size(), root.characters(), cmake_paths.size());
+    printf("%-18s %12s %12s %9s\n", "substitution", "regex ns", "expander ns", "speedup");
+    auto report = [&](const char* name, double old_ns, double new_ns) {
+        printf("%-18s %12.1f %12.1f %8.1fx\n", name, old_ns, new_ns, old_ns / new_ns);
+    };
+
+    // the regex version is far slower, run it a tenth as often
+    int old_iterations = iterations / 10 ? iterations / 10 : 1;
+    report("path variables",
+        time_per_call_ns(paths, old_iterations, [&](const String& path) { return old_expand(path, path_variables); }),
+        time_per_call_ns(paths, iterations, [&](const String& path) { return new_expand(path, path_table); }));
+    report("cmake variables",
+        time_per_call_ns(cmake_paths, old_iterations, [&](const String& path) { return old_expand(path, cmake_variables); }),
+        time_per_call_ns(cmake_paths, iterations, [&](const String& path) { return new_expand(path, cmake_table); }));
+    return 0;
+}
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Generate a synthetic meta tree of configurable size for benchmarking.
+
+The tree uses the toolchain of the bundled serenity tree and adds an image and
+a number of library and executable packages. Every package depends on up to
+--fan-out packages with a lower number, so the dependency graph is acyclic and
+deep, and finds its sources with a glob pattern in a directory that is nested
+--depth levels deep.
+"""
+
+import argparse
+import json
+import os
+import random
+import shutil
+import sys
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+SERENITY_DIR = os.path.join(os.path.dirname(SCRIPT_DIR), "serenity")
+
+
+def write_json(path, content):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "w") as f:
+        json.dump(content, f, indent=4)
+        f.write("\n")
+
+
+def package_directory(index, depth, width):
+    # spreads the packages over a directory tree with width subdirectories per level
+    parts = []
+    rest = index
+    for level in range(depth):
+        parts.append("group%d_%d" % (level, rest % width))
+        rest //= width
+    parts.append("Pkg%d" % index)
+    return os.path.join(*parts)
+
+
+def generate(args):
+    root = os.path.abspath(args.output)
+    if os.path.exists(root):
+        shutil.rmtree(root)
+    os.makedirs(root)
+    rng = random.Random(args.seed)
+
+    write_json(os.path.join(root, "project-settings.m.json"), {
+        "settings": {
+            "project": {
+                "root": root,
+                "toolchain": "default",
+                "build_directory": os.path.join(root, "build"),
+                "gendata_directory": os.path.join(root, "build-gen"),
+                "build_generator": "cmake",
+                "build_configuration": {
+                    "tool": "make",
+                    "parallel_jobs": 4
+                }
+            }
+        }
+    })
+
+    shutil.copy(os.path.join(SERENITY_DIR, "toolchain.m.json"), root)
+    shutil.copytree(os.path.join(SERENITY_DIR, "Toolchain"), os.path.join(root, "Toolchain"),
+                    ignore=shutil.ignore_patterns("*.sh"))
+
+    with open(os.path.join(SERENITY_DIR, "default-image.m.json")) as f:
+        image = json.load(f)["image"]["default-image"]
+    write_json(os.path.join(root, "bench-image.m.json"), {"image": {"bench-image": image}})
+
+    source_files = 0
+    for index in range(args.packages):
+        directory = package_directory(index, args.depth, args.width)
+        source_directory = os.path.join(root, directory)
+        os.makedirs(os.path.join(source_directory, "detail"))
+        for file_index in range(args.sources):
+            # half of the files in a subdirectory, which only the recursive pattern finds
+            subdirectory = "detail" if file_index % 2 else ""
+            name = "Pkg%d_%d.cpp" % (index, file_index)
+            with open(os.path.join(source_directory, subdirectory, name), "w") as f:
+                f.write("int pkg%d_%d() { return %d; }\n" % (index, file_index, file_index))
+            source_files += 1
+        with open(os.path.join(source_directory, "Pkg%d.h" % index), "w") as f:
+            f.write("#pragma once\nint pkg%d_0();\n" % index)
+
+        candidates = min(index, args.fan_out)
+        dependencies = ["Pkg%d" % d for d in rng.sample(range(index), candidates)] if candidates else []
+
+        package = {
+            "type": "executable" if index % args.executable_every == args.executable_every - 1 else "library",
+            "source": [
+                "${root}/%s/*.cpp" % directory,
+                "${root}/%s/detail/**/*.cpp" % directory
+            ],
+            "include": [
+                "${root}/%s" % directory
+            ]
+        }
+        if dependencies:
+            package["dependency"] = dependencies
+        write_json(os.path.join(source_directory, "Pkg%d.m.json" % index), {"package": {"Pkg%d" % index: package}})
+
+    print("Generated %d packages with %d source files in %s" % (args.packages, source_files, root))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output", help="directory of the tree, replaced if it exists")
+    parser.add_argument("--packages", type=int, default=1000, help="number of packages (default: 1000)")
+    parser.add_argument("--fan-out", type=int, default=4, help="direct dependencies per package (default: 4)")
+    parser.add_argument("--sources", type=int, default=4, help="source files per package (default: 4)")
+    parser.add_argument("--depth", type=int, default=3, help="directory levels above each package (default: 3)")
+    parser.add_argument("--width", type=int, default=8, help="subdirectories per directory level (default: 8)")
+    parser.add_argument("--executable-every", type=int, default=10,
+                        help="every n-th package is an executable (default: 10)")
+    parser.add_argument("--seed", type=int, default=1, help="seed for choosing the dependencies (default: 1)")
+    args = parser.parse_args()
+    if args.packages < 1 or args.fan_out < 0 or args.sources < 1 or args.depth < 0 or args.width < 1 \
+            or args.executable_every < 1:
+        parser.error("sizes must be positive")
+    generate(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Time meta on synthetic trees of increasing size.
+
+For every size a tree is generated with generate_tree.py, then
+"meta gen bench-image" runs in it with --trace, once without and once with a
+filled glob cache. The trace events are attributed by their self time to the
+phases discovery (finding meta json files and expanding globs), parse (reading
+the json files and adding packages), resolve (probing host dependencies and
+resolving the dependency trees) and generate (writing the gendata directory).
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+PHASES = {
+    "discovery": ["find settings", "find meta json files", "expand glob", "load glob cache", "save glob cache"],
+    "parse": ["load settings", "load meta json files", "parse json", "add package", "freeze databases"],
+    "resolve": ["probe host dependencies", "resolve dependencies"],
+    "generate": ["gen_root", "gen_toolchain", "gen_image", "gen_package"],
+}
+PHASE_OF_EVENT = {name: phase for phase, names in PHASES.items() for name in names}
+
+
+def self_times(events):
+    # the events of one thread nest properly, the self time of an event excludes its children
+    events = sorted(events, key=lambda e: (e["ts"], -e["dur"]))
+    self_us = [e["dur"] for e in events]
+    open_events = []
+    for index, event in enumerate(events):
+        while open_events and events[open_events[-1]]["ts"] + events[open_events[-1]]["dur"] <= event["ts"]:
+            open_events.pop()
+        if open_events:
+            self_us[open_events[-1]] -= event["dur"]
+        open_events.append(index)
+    return zip(events, self_us)
+
+
+def run_meta(meta, tree, trace_filename, extra_options):
+    # a trace left behind by an earlier run must not be read if this one does not write it
+    if os.path.exists(trace_filename):
+        os.unlink(trace_filename)
+    command = [meta, "gen", "bench-image", "--no-server", "--trace", trace_filename] + extra_options
+    start = time.monotonic()
+    with open(os.devnull, "w") as devnull:
+        process = subprocess.Popen(command, cwd=tree, stdout=devnull)
+        _, status, usage = os.wait4(process.pid, 0)
+    wall = time.monotonic() - start
+    if os.WIFSIGNALED(status):
+        sys.exit("%s was killed by signal %d in %s" % (" ".join(command), os.WTERMSIG(status), tree))
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        sys.exit("%s failed in %s" % (" ".join(command), tree))
+    if not os.path.exists(trace_filename):
+        sys.exit("%s wrote no trace in %s" % (" ".join(command), tree))
+
+    with open(trace_filename) as f:
+        events = [e for e in json.load(f)["traceEvents"] if e.get("ph") == "X"]
+    phases = {phase: 0 for phase in PHASES}
+    # every glob cache miss expands its pattern, without the cache every lookup does
+    glob_expansions = sum(1 for e in events if e["name"] == "expand glob")
+    for event, self_us in self_times(events):
+        phase = PHASE_OF_EVENT.get(event["name"])
+        if phase:
+            phases[phase] += self_us
+    # ru_maxrss is in KiB on Linux
+    return {"wall_s": wall, "peak_rss_kib": usage.ru_maxrss, "phases_us": phases, "glob_expansions": glob_expansions}
+
+
+def backdate_directories(tree, seconds):
+    # the glob cache does not save directories modified within the last second, a tree
+    # that was just written would give the warm run no hits
+    mtime = time.time() - seconds
+    for directory, _, _ in os.walk(tree):
+        os.utime(directory, (mtime, mtime))
+
+
+def print_result(packages, name, result):
+    phases = result["phases_us"]
+    row = "%9d  %-6s %9.3f" % (packages, name, result["wall_s"])
+    for phase in PHASES:
+        row += " %9.1f" % (phases[phase] / 1000.0)
+    row += " %11.0f %9.1f %9d" % (packages / result["wall_s"], result["peak_rss_kib"] / 1024.0,
+                                  result["glob_expansions"])
+    print(row)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--meta", default=os.path.join(os.path.dirname(SCRIPT_DIR), "meta"),
+                        help="meta binary to measure (default: the one in the repository root)")
+    parser.add_argument("--packages", type=int, nargs="+", default=[100, 1000, 10000],
+                        help="tree sizes in packages (default: 100 1000 10000)")
+    parser.add_argument("--directory", help="keep the generated trees in this directory instead of a temporary one")
+    parser.add_argument("--json", help="also write the results to this file")
+    parser.add_argument("generator_options", nargs=argparse.REMAINDER,
+                        help="options after -- are passed to generate_tree.py, e.g. -- --fan-out 8")
+    args = parser.parse_args()
+    meta = os.path.abspath(args.meta)
+    if not os.access(meta, os.X_OK):
+        sys.exit("meta binary not found: %s" % meta)
+    generator_options = [o for o in args.generator_options if o != "--"]
+
+    work_directory = args.directory or tempfile.mkdtemp(prefix="meta-benchmark-")
+    print("%9s  %-6s %9s %9s %9s %9s %9s %11s %9s %9s" % ("packages", "run", "wall s", "discovery", "parse",
+                                                          "resolve", "generate", "packages/s", "rss MiB", "expanded"))
+    print("%9s  %-6s %9s %9s %9s %9s %9s %11s %9s %9s" % ("", "", "", "ms", "ms", "ms", "ms", "", "", "globs"))
+    results = []
+    for packages in args.packages:
+        tree = os.path.join(work_directory, "tree-%d" % packages)
+        subprocess.check_call([sys.executable, os.path.join(SCRIPT_DIR, "generate_tree.py"), tree,
+                               "--packages", str(packages)] + generator_options, stdout=subprocess.DEVNULL)
+        def trace(run):
+            return os.path.join(work_directory, "trace-%d-%s.json" % (packages, run))
+        # the first run fills the glob cache that the second one uses
+        cold = run_meta(meta, tree, trace("cold"), ["--no-glob-cache"])
+        backdate_directories(tree, 10)
+        run_meta(meta, tree, trace("fill"), [])
+        warm = run_meta(meta, tree, trace("warm"), [])
+        warm["glob_cache_hits"] = cold["glob_expansions"] - warm["glob_expansions"]
+        if warm["glob_cache_hits"] <= 0:
+            sys.exit("the warm run in %s found nothing in the glob cache, it expanded %d patterns"
+                     % (tree, warm["glob_expansions"]))
+        print_result(packages, "cold", cold)
+        print_result(packages, "warm", warm)
+        results.append({"packages": packages, "cold": cold, "warm": warm})
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=4)
+            f.write("\n")
+    if not args.directory:
+        print("Trees and traces are in %s" % work_directory)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
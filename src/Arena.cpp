@@ -0,0 +1,354 @@
+#include "Arena.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void* __libc_valloc(size_t);
+void* __libc_pvalloc(size_t);
+void __libc_free(void*);
+}
+#    define system_malloc __libc_malloc
+#    define system_calloc __libc_calloc
+#    define system_realloc __libc_realloc
+#    define system_memalign __libc_memalign
+#    define system_free __libc_free
+#else
+#    define system_malloc malloc
+#    define system_calloc calloc
+#    define system_realloc realloc
+#    define system_memalign(alignment, size) aligned_alloc(alignment, size)
+#    define system_free free
+#endif
+
+namespace Arena {
+
+// only address space is reserved, pages are committed on first touch
+static constexpr size_t reserved_size = 16ul * 1024 * 1024 * 1024;
+static constexpr size_t alignment = 16;
+
+struct Header {
+    size_t size;
+    size_t padding;
+};
+static_assert(sizeof(Header) % alignment == 0, "Arena header breaks alignment");
+
+static Statistics s_statistics;
+// Set once at startup before any thread exists. Unless one of them is set, the interposed
+// functions only test s_active and call the ones of the C library.
+static bool s_enabled;
+static bool s_counting;
+static bool s_active;
+static u8* s_begin;
+static u8* s_current;
+static u8* s_end;
+
+void enable()
+{
+    if (s_enabled)
+        return;
+
+    void* region = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+
+    s_begin = s_current = (u8*)region;
+    s_end = s_begin + reserved_size;
+    s_enabled = true;
+    s_active = true;
+}
+
+void enable_statistics()
+{
+    s_counting = true;
+    s_active = true;
+}
+
+bool is_enabled()
+{
+    return s_enabled;
+}
+
+Statistics statistics()
+{
+    Statistics statistics;
+    statistics.allocations = __atomic_load_n(&s_statistics.allocations, __ATOMIC_RELAXED);
+    statistics.deallocations = __atomic_load_n(&s_statistics.deallocations, __ATOMIC_RELAXED);
+    statistics.bytes_requested = __atomic_load_n(&s_statistics.bytes_requested, __ATOMIC_RELAXED);
+    statistics.arena_bytes_used = __atomic_load_n(&s_statistics.arena_bytes_used, __ATOMIC_RELAXED);
+    return statistics;
+}
+
+void dump_statistics(const char* label)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    auto current = statistics();
+    fprintf(stderr, "%s: %lu allocations, %lu frees, %lu bytes requested, %lu bytes in arena, peak RSS %ld KiB\n",
+        label,
+        (unsigned long)current.allocations,
+        (unsigned long)current.deallocations,
+        (unsigned long)current.bytes_requested,
+        (unsigned long)current.arena_bytes_used,
+        usage.ru_maxrss);
+}
+
+static void count(size_t& counter, size_t value)
+{
+    if (s_counting)
+        __atomic_fetch_add(&counter, value, __ATOMIC_RELAXED);
+}
+
+static bool owns(void* ptr)
+{
+    return ptr >= s_begin && ptr < s_end;
+}
+
+// the header is directly in front of the returned memory, so larger alignments pad before it
+static void* arena_allocate(size_t size, size_t requested_alignment)
+{
+    size_t rounded_size = (size + alignment - 1) & ~(alignment - 1);
+    if (rounded_size < size)
+        return nullptr;
+
+    u8* current = __atomic_load_n(&s_current, __ATOMIC_RELAXED);
+    u8* memory;
+    u8* next;
+    do {
+        memory = current + sizeof(Header);
+        if (requested_alignment > alignment)
+            memory = (u8*)(((uintptr_t)memory + requested_alignment - 1) & ~(uintptr_t)(requested_alignment - 1));
+        if (memory > s_end || (size_t)(s_end - memory) < rounded_size)
+            return nullptr;
+        next = memory + rounded_size;
+    } while (!__atomic_compare_exchange_n(&s_current, &current, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    auto* header = (Header*)memory - 1;
+    header->size = size;
+    count(s_statistics.arena_bytes_used, next - current);
+    return memory;
+}
+
+static void* allocate(size_t size, size_t requested_alignment = alignment)
+{
+    count(s_statistics.allocations, 1);
+    count(s_statistics.bytes_requested, size);
+
+    if (s_enabled) {
+        if (auto* ptr = arena_allocate(size, requested_alignment))
+            return ptr;
+    }
+    if (requested_alignment > alignment)
+        return system_memalign(requested_alignment, size);
+    return system_malloc(size);
+}
+
+static void deallocate(void* ptr)
+{
+    if (!ptr)
+        return;
+
+    count(s_statistics.deallocations, 1);
+    // arena memory is released as a whole when the process exits
+    if (owns(ptr))
+        return;
+    system_free(ptr);
+}
+
+static void release(void* ptr)
+{
+    if (!s_active)
+        return system_free(ptr);
+    deallocate(ptr);
+}
+
+static void* reallocate(void* ptr, size_t size)
+{
+    if (!ptr)
+        return allocate(size);
+
+    if (!owns(ptr)) {
+        count(s_statistics.bytes_requested, size);
+        return system_realloc(ptr, size);
+    }
+
+    size_t old_size = ((Header*)ptr - 1)->size;
+    if (size <= old_size)
+        return ptr;
+
+    void* new_ptr = allocate(size);
+    if (new_ptr)
+        memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+static size_t usable_size(void* ptr)
+{
+    if (owns(ptr))
+        return ((Header*)ptr - 1)->size;
+
+    // the C library has no internal name for it, look up the one this file interposes
+    using UsableSize = size_t (*)(void*);
+    static UsableSize s_system_usable_size;
+    if (!s_system_usable_size)
+        s_system_usable_size = (UsableSize)dlsym(RTLD_NEXT, "malloc_usable_size");
+    return s_system_usable_size ? s_system_usable_size(ptr) : 0;
+}
+
+static bool multiply_overflows(size_t count, size_t size)
+{
+    return size && count > (size_t)-1 / size;
+}
+
+static void* allocate_or_die(size_t size)
+{
+    void* ptr = s_active ? allocate(size) : system_malloc(size);
+    if (!ptr) {
+        fprintf(stderr, "Out of memory: could not allocate %lu bytes\n", (unsigned long)size);
+        abort();
+    }
+    return ptr;
+}
+
+}
+
+#ifdef __GLIBC__
+// glibc lets the executable interpose the malloc family, this also covers AK's kmalloc.
+// Every function that takes or returns heap memory is replaced, so no pointer into the
+// arena reaches the allocator of the C library.
+extern "C" {
+
+void* malloc(size_t size)
+{
+    if (!Arena::s_active)
+        return system_malloc(size);
+    return Arena::allocate(size);
+}
+
+void free(void* ptr)
+{
+    Arena::release(ptr);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    if (!Arena::s_active)
+        return system_calloc(count, size);
+    if (Arena::multiply_overflows(count, size))
+        return nullptr;
+    void* ptr = Arena::allocate(count * size);
+    if (ptr)
+        memset(ptr, 0, count * size);
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    if (!Arena::s_active)
+        return system_realloc(ptr, size);
+    return Arena::reallocate(ptr, size);
+}
+
+void* reallocarray(void* ptr, size_t count, size_t size)
+{
+    if (Arena::multiply_overflows(count, size)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(ptr, count * size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    if (!Arena::s_active)
+        return system_memalign(alignment, size);
+    if (!alignment || (alignment & (alignment - 1))) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return Arena::allocate(size, alignment);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size)
+{
+    if (!alignment || (alignment & (alignment - 1)) || alignment % sizeof(void*))
+        return EINVAL;
+    void* ptr = memalign(alignment, size);
+    if (!ptr)
+        return ENOMEM;
+    *result = ptr;
+    return 0;
+}
+
+void* valloc(size_t size)
+{
+    if (!Arena::s_active)
+        return __libc_valloc(size);
+    return Arena::allocate(size, sysconf(_SC_PAGESIZE));
+}
+
+void* pvalloc(size_t size)
+{
+    if (!Arena::s_active)
+        return __libc_pvalloc(size);
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    return Arena::allocate((size + page_size - 1) & ~(page_size - 1), page_size);
+}
+
+size_t malloc_usable_size(void* ptr)
+{
+    if (!ptr)
+        return 0;
+    return Arena::usable_size(ptr);
+}
+}
+#endif
+
+void* operator new(size_t size)
+{
+    return Arena::allocate_or_die(size);
+}
+
+void* operator new[](size_t size)
+{
+    return Arena::allocate_or_die(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    Arena::release(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    Arena::release(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    Arena::release(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    Arena::release(ptr);
+}
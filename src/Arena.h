@@ -0,0 +1,25 @@
+#pragma once
+
+#include <AK/Types.h>
+
+// Process wide bump allocator for a meta run. Nearly everything allocated while parsing,
+// resolving and generating lives until the process exits, so freeing is a no-op for
+// memory that has been handed out by the arena.
+namespace Arena {
+
+struct Statistics {
+    size_t allocations { 0 };
+    size_t deallocations { 0 };
+    size_t bytes_requested { 0 };
+    size_t arena_bytes_used { 0 };
+};
+
+void enable();
+// counts the allocations of the run, without it and enable() meta uses the C library allocator
+void enable_statistics();
+bool is_enabled();
+
+Statistics statistics();
+void dump_statistics(const char* label);
+
+}
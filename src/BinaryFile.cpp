@@ -0,0 +1,192 @@
+#include "BinaryFile.h"
+#include "StringUtils.h"
+#include <AK/StringBuilder.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr size_t s_magic_length = 8;
+// the length of a null string, which is kept apart from an empty one
+static constexpr u32 s_null_string = 0xffffffff;
+
+struct [[gnu::packed]] BinaryFileHeader {
+    char magic[s_magic_length];
+    u32 version;
+    u64 content_size;
+    u64 checksum;
+};
+
+void BinaryWriter::write_string(const StringView& string)
+{
+    if (string.is_null()) {
+        write_value(s_null_string);
+        return;
+    }
+    write_value((u32)string.length());
+    m_data.append((const u8*)string.characters_without_null_termination(), string.length());
+}
+
+void BinaryWriter::write_strings(const Vector<String>& strings)
+{
+    write_value((u32)strings.size());
+    for (auto& string : strings)
+        write_string(string);
+}
+
+void BinaryWriter::write_string_map(const HashMap<String, String>& map)
+{
+    write_value((u32)map.size());
+    for (auto& it : map) {
+        write_string(it.key);
+        write_string(it.value);
+    }
+}
+
+bool BinaryWriter::write_file(const String& filename, const char* magic, u32 version) const
+{
+    BinaryFileHeader header;
+    memcpy(header.magic, magic, s_magic_length);
+    header.version = version;
+    header.content_size = m_data.size();
+    header.checksum = fnv1a_hash(StringView((const char*)m_data.data(), m_data.size()));
+
+    // a unique file next to the target, so the rename is atomic and no other run writes to it
+    StringBuilder template_builder;
+    template_builder.appendf("%s.XXXXXX", filename.characters());
+    auto tmp_template = template_builder.build();
+    Vector<char> tmp_filename;
+    tmp_filename.append(tmp_template.characters(), tmp_template.length() + 1);
+
+    int fd = mkstemp(tmp_filename.data());
+    if (fd < 0) {
+        fprintf(stderr, "Could not create %s: %s\n", tmp_template.characters(), strerror(errno));
+        return false;
+    }
+    fchmod(fd, 0644);
+
+    auto write_all = [&](const void* data, size_t size) {
+        const u8* bytes = (const u8*)data;
+        while (size) {
+            ssize_t nwritten = write(fd, bytes, size);
+            if (nwritten < 0 && errno == EINTR)
+                continue;
+            if (nwritten <= 0)
+                return false;
+            bytes += nwritten;
+            size -= nwritten;
+        }
+        return true;
+    };
+
+    bool ok = write_all(&header, sizeof(header)) && write_all(m_data.data(), m_data.size());
+    if (close(fd) < 0)
+        ok = false;
+    if (!ok || rename(tmp_filename.data(), filename.characters()) < 0) {
+        fprintf(stderr, "Could not write %s: %s\n", filename.characters(), strerror(errno));
+        unlink(tmp_filename.data());
+        return false;
+    }
+    return true;
+}
+
+String BinaryReader::read_string()
+{
+    u32 length = read_value<u32>();
+    if (length == s_null_string)
+        return {};
+    if (m_size - m_offset < length) {
+        m_error = true;
+        m_offset = m_size;
+        return {};
+    }
+    String string((const char*)m_data + m_offset, length);
+    m_offset += length;
+    return string;
+}
+
+bool BinaryReader::skip_string()
+{
+    u32 length = read_value<u32>();
+    if (length == s_null_string)
+        return !m_error;
+    if (m_size - m_offset < length) {
+        m_error = true;
+        m_offset = m_size;
+        return false;
+    }
+    m_offset += length;
+    return !m_error;
+}
+
+Vector<String> BinaryReader::read_strings()
+{
+    Vector<String> strings;
+    u32 count = read_value<u32>();
+    for (u32 i = 0; i < count && !m_error; ++i)
+        strings.append(read_string());
+    return strings;
+}
+
+HashMap<String, String> BinaryReader::read_string_map()
+{
+    HashMap<String, String> map;
+    u32 count = read_value<u32>();
+    for (u32 i = 0; i < count && !m_error; ++i) {
+        auto key = read_string();
+        map.set(key, read_string());
+    }
+    return map;
+}
+
+OwnPtr<MappedBinaryFile> MappedBinaryFile::map(const String& filename, const char* magic, u32 version)
+{
+    int fd = open(filename.characters(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BinaryFileHeader)) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        return nullptr;
+    }
+
+    // outdated or foreign files are silently replaced on the next save
+    BinaryFileHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    const u8* content = (const u8*)mapping + sizeof(header);
+    size_t content_size = st.st_size - sizeof(header);
+    if (memcmp(header.magic, magic, s_magic_length) || header.version != version) {
+        munmap(mapping, st.st_size);
+        return nullptr;
+    }
+    if (header.content_size != content_size || header.checksum != fnv1a_hash(StringView((const char*)content, content_size))) {
+        fprintf(stderr, "%s is corrupt, ignoring it.\n", filename.characters());
+        munmap(mapping, st.st_size);
+        return nullptr;
+    }
+    return OwnPtr<MappedBinaryFile>(new MappedBinaryFile(mapping, st.st_size, content, content_size));
+}
+
+MappedBinaryFile::MappedBinaryFile(void* mapping, size_t mapping_size, const u8* content, size_t content_size)
+    : m_mapping(mapping)
+    , m_mapping_size(mapping_size)
+    , m_content(content)
+    , m_content_size(content_size)
+{
+}
+
+MappedBinaryFile::~MappedBinaryFile()
+{
+    munmap(m_mapping, m_mapping_size);
+}
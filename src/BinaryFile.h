@@ -0,0 +1,90 @@
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/OwnPtr.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <string.h>
+
+// The caches of meta in the gendata directory are flat binary files: a magic, a version,
+// the size and a checksum of the content, then the content. A file that does not match
+// is ignored and replaced on the next save. Files are written to a unique temporary
+// file and renamed, so concurrent runs of meta never read or produce a partial file.
+
+class BinaryWriter {
+public:
+    template<typename T>
+    void write_value(T value)
+    {
+        m_data.append((const u8*)&value, sizeof(T));
+    }
+
+    void write_string(const StringView&);
+    void write_strings(const Vector<String>&);
+    void write_string_map(const HashMap<String, String>&);
+
+    size_t size() const { return m_data.size(); }
+
+    bool write_file(const String& filename, const char* magic, u32 version) const;
+
+private:
+    Vector<u8> m_data;
+};
+
+// Reads the content of a mapped file. Reading past the end returns empty values and marks
+// the reader as failed, so callers check has_error() once after reading a whole record.
+class BinaryReader {
+public:
+    BinaryReader(const u8* data, size_t size, size_t offset = 0)
+        : m_data(data)
+        , m_size(size)
+        , m_offset(offset)
+    {
+    }
+
+    template<typename T>
+    T read_value()
+    {
+        T value {};
+        if (m_size - m_offset < sizeof(T)) {
+            m_error = true;
+            m_offset = m_size;
+            return value;
+        }
+        memcpy(&value, m_data + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return value;
+    }
+
+    String read_string();
+    Vector<String> read_strings();
+    HashMap<String, String> read_string_map();
+    bool skip_string();
+
+    size_t offset() const { return m_offset; }
+    bool at_end() const { return m_offset == m_size; }
+    bool has_error() const { return m_error; }
+
+private:
+    const u8* m_data;
+    size_t m_size;
+    size_t m_offset;
+    bool m_error { false };
+};
+
+class MappedBinaryFile {
+public:
+    // nullptr if the file does not exist or has another magic, version or checksum
+    static OwnPtr<MappedBinaryFile> map(const String& filename, const char* magic, u32 version);
+    ~MappedBinaryFile();
+
+    BinaryReader reader(size_t offset = 0) const { return BinaryReader(m_content, m_content_size, offset); }
+
+private:
+    MappedBinaryFile(void* mapping, size_t mapping_size, const u8* content, size_t content_size);
+
+    void* m_mapping;
+    size_t m_mapping_size;
+    const u8* m_content;
+    size_t m_content_size;
+};
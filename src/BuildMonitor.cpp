@@ -0,0 +1,455 @@
+#include "BuildMonitor.h"
+#include <AK/QuickSort.h>
+#include <AK/StringBuilder.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static constexpr u64 s_frame_interval_ms = 100;
+static constexpr size_t s_max_recent_lines = 30;
+
+static volatile sig_atomic_t s_cursor_hidden;
+static volatile pid_t s_child_pid;
+
+static const int s_signals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT };
+static struct sigaction s_previous_actions[sizeof(s_signals) / sizeof(s_signals[0])];
+
+extern char** environ;
+
+// The output of the command goes through pipes, so compilers and build tools would see no
+// terminal and drop their colors. If meta prints to a terminal, they are told to keep them:
+// CLICOLOR_FORCE for make, ninja and cmake, CMAKE_COLOR_DIAGNOSTICS for the compiler flags of
+// build directories configured by this command. Variables set by the user and NO_COLOR win.
+static Vector<const char*> command_environment(bool force_color)
+{
+    static const char* s_color_variables[] = { "CLICOLOR_FORCE=1", "CMAKE_COLOR_DIAGNOSTICS=ON" };
+
+    Vector<const char*> environment;
+    for (char** variable = environ; *variable; ++variable)
+        environment.append(*variable);
+    if (force_color && !getenv("NO_COLOR")) {
+        for (auto* variable : s_color_variables) {
+            String name(variable, strchr(variable, '=') - variable);
+            if (!getenv(name.characters()))
+                environment.append(variable);
+        }
+    }
+    environment.append(nullptr);
+    return environment;
+}
+
+static u64 now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool find(const StringView& haystack, const StringView& needle, size_t& index)
+{
+    auto* found = (const char*)memmem(haystack.characters_without_null_termination(), haystack.length(), needle.characters_without_null_termination(), needle.length());
+    if (!found)
+        return false;
+    index = found - haystack.characters_without_null_termination();
+    return true;
+}
+
+static StringView after(const StringView& line, size_t index)
+{
+    return line.substring_view(index, line.length() - index);
+}
+
+static bool parse_number(const StringView& line, size_t& index, u32& number)
+{
+    size_t start = index;
+    number = 0;
+    while (index < line.length() && line[index] >= '0' && line[index] <= '9')
+        number = number * 10 + (line[index++] - '0');
+    return index > start;
+}
+
+// make: "[ 45%] Building CXX object ..."
+static bool parse_make_progress(const StringView& line, u32& percent)
+{
+    size_t index = 1;
+    if (!line.starts_with("["))
+        return false;
+    while (index < line.length() && line[index] == ' ')
+        ++index;
+    return parse_number(line, index, percent) && after(line, index).starts_with("%]") && percent <= 100;
+}
+
+// ninja: "[12/345] Building CXX object ..."
+// done and total are only changed if the whole "[done/total]" prefix parses
+static bool parse_ninja_progress(const StringView& line, u32& done, u32& total)
+{
+    size_t index = 1;
+    u32 parsed_done = 0;
+    u32 parsed_total = 0;
+    if (!line.starts_with("[") || !parse_number(line, index, parsed_done) || !after(line, index).starts_with("/"))
+        return false;
+    ++index;
+    if (!parse_number(line, index, parsed_total) || !after(line, index).starts_with("]") || parsed_done > parsed_total)
+        return false;
+    done = parsed_done;
+    total = parsed_total;
+    return true;
+}
+
+static String without_escape_sequences(const StringView& line)
+{
+    StringBuilder builder;
+    for (size_t i = 0; i < line.length(); ++i) {
+        if (line[i] != '\033') {
+            builder.append(line[i]);
+            continue;
+        }
+        // skip a CSI sequence like "\033[1;32m"
+        if (i + 1 < line.length() && line[i + 1] == '[') {
+            i += 2;
+            while (i < line.length() && !(line[i] >= '@' && line[i] <= '~'))
+                ++i;
+        }
+    }
+    return builder.build();
+}
+
+static void handle_signal(int signal_number)
+{
+    if (s_cursor_hidden) {
+        static const char restore[] = "\r\033[K\033[?25h";
+        if (write(STDOUT_FILENO, restore, sizeof(restore) - 1) < 0) {
+        }
+    }
+
+    // the command runs in its own process group, so the signal reaches make, ninja and the
+    // compilers they started, including SIGINT and SIGQUIT the terminal only sent to meta
+    if (s_child_pid > 0)
+        kill(-s_child_pid, signal_number);
+
+    // terminate with the default action of the signal
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+static void install_signal_handlers()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    for (size_t i = 0; i < sizeof(s_signals) / sizeof(s_signals[0]); ++i)
+        sigaction(s_signals[i], &action, &s_previous_actions[i]);
+}
+
+static void restore_signal_handlers()
+{
+    for (size_t i = 0; i < sizeof(s_signals) / sizeof(s_signals[0]); ++i)
+        sigaction(s_signals[i], &s_previous_actions[i], nullptr);
+}
+
+BuildMonitor::BuildMonitor(bool suppress_output)
+    : m_suppress_output(suppress_output)
+    , m_interactive(isatty(STDOUT_FILENO))
+{
+}
+
+int BuildMonitor::run(const String& command)
+{
+    int stdout_pipe[2];
+    int stderr_pipe[2];
+    if (pipe2(stdout_pipe, O_CLOEXEC) < 0 || pipe2(stderr_pipe, O_CLOEXEC) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    // built before fork, the child only calls async-signal-safe functions
+    auto environment = command_environment(m_interactive);
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        setpgid(0, 0);
+        dup2(stdout_pipe[1], STDOUT_FILENO);
+        dup2(stderr_pipe[1], STDERR_FILENO);
+        execle("/bin/sh", "sh", "-c", command.characters(), nullptr, (char* const*)environment.data());
+        perror("execle");
+        _exit(127);
+    }
+
+    // also in the parent, so the group exists before a signal can be forwarded to it
+    setpgid(pid, pid);
+    close(stdout_pipe[1]);
+    close(stderr_pipe[1]);
+
+    s_child_pid = pid;
+    install_signal_handlers();
+
+    m_start_ms = now_ms();
+    if (m_interactive) {
+        fputs("\033[?25l", stdout);
+        s_cursor_hidden = 1;
+        draw_status(true);
+    }
+
+    Stream streams[2] = {
+        { stdout_pipe[0], stdout, true, {} },
+        { stderr_pipe[0], stderr, true, {} },
+    };
+    size_t open_streams = 2;
+
+    while (open_streams) {
+        struct pollfd fds[2];
+        Stream* polled_streams[2];
+        nfds_t nfds = 0;
+        for (auto& stream : streams) {
+            if (!stream.open)
+                continue;
+            fds[nfds] = { stream.fd, POLLIN, 0 };
+            polled_streams[nfds++] = &stream;
+        }
+
+        // wake up for the next frame of the animation, otherwise only on output
+        int timeout = -1;
+        if (m_interactive && m_at_line_start) {
+            u64 since_last_frame = now_ms() - m_last_frame_ms;
+            timeout = since_last_frame >= s_frame_interval_ms ? 0 : (int)(s_frame_interval_ms - since_last_frame);
+        }
+
+        int rc = poll(fds, nfds, timeout);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+
+        for (nfds_t i = 0; i < nfds; ++i) {
+            if (!fds[i].revents)
+                continue;
+
+            auto& stream = *polled_streams[i];
+            char buffer[4096];
+            ssize_t nread = read(stream.fd, buffer, sizeof(buffer));
+            if (nread < 0 && errno == EINTR)
+                continue;
+
+            if (nread <= 0) {
+                if (!stream.line.is_empty()) {
+                    handle_line(StringView(stream.line.data(), stream.line.size()));
+                    stream.line.clear();
+                }
+                close(stream.fd);
+                stream.open = false;
+                --open_streams;
+                continue;
+            }
+            handle_output(stream, buffer, nread);
+        }
+
+        if (m_interactive)
+            draw_status(false);
+    }
+
+    for (auto& stream : streams) {
+        if (stream.open)
+            close(stream.fd);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            break;
+        }
+    }
+    s_child_pid = 0;
+
+    if (m_interactive) {
+        clear_status();
+        fputs("\033[?25h", stdout);
+        fflush(stdout);
+        s_cursor_hidden = 0;
+    }
+    restore_signal_handlers();
+
+    if (!m_targets.is_empty() && !m_report_filename.is_empty())
+        write_report();
+
+    int exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if (exit_status && m_suppress_output) {
+        fprintf(stderr, "Command failed with exit status %i, last output:\n", exit_status);
+        for (auto& line : m_recent_lines)
+            fprintf(stderr, "  %s\n", line.characters());
+    }
+    return exit_status;
+}
+
+void BuildMonitor::handle_output(Stream& stream, const char* data, size_t size)
+{
+    // forward output right away, commands like "run" may print partial lines
+    if (!m_suppress_output) {
+        clear_status();
+        fwrite(data, 1, size, stream.output);
+        fflush(stream.output);
+        m_at_line_start = data[size - 1] == '\n';
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] != '\n') {
+            stream.line.append(data[i]);
+            continue;
+        }
+        handle_line(StringView(stream.line.data(), stream.line.size()));
+        stream.line.clear();
+    }
+}
+
+void BuildMonitor::handle_line(const StringView& raw_line)
+{
+    if (m_suppress_output) {
+        if (m_recent_lines.size() == s_max_recent_lines)
+            m_recent_lines.take_first();
+        m_recent_lines.append(raw_line);
+    }
+
+    StringView line = raw_line;
+    String stripped;
+    size_t index;
+    if (find(line, "\033", index)) {
+        stripped = without_escape_sequences(line);
+        line = stripped;
+    }
+    if (!line.is_empty() && line[line.length() - 1] == '\r')
+        line = line.substring_view(0, line.length() - 1);
+
+    u32 percent;
+    if (parse_ninja_progress(line, m_steps_done, m_steps_total))
+        m_progress = m_steps_total ? (u64)m_steps_done * 1000 / m_steps_total : 0;
+    else if (parse_make_progress(line, percent))
+        m_progress = percent * 10;
+
+    if (find(line, "Built target ", index)) {
+        update_target(after(line, index + 13), true);
+    } else if (find(line, "Scanning dependencies of target ", index)) {
+        update_target(after(line, index + 32), false);
+    } else if (find(line, "CMakeFiles/", index)) {
+        auto directory = after(line, index + 11);
+        if (find(directory, ".dir/", index))
+            update_target(directory.substring_view(0, index), false);
+    }
+}
+
+// A target is timed from the first to the last line of output that mentions it, for make
+// that is the "Built target" line. Targets of parallel builds overlap.
+void BuildMonitor::update_target(const StringView& target, bool built)
+{
+    if (target.is_empty())
+        return;
+
+    u64 now = now_ms();
+    auto it = m_targets.find(target);
+    if (it == m_targets.end()) {
+        m_targets.set(target, { now, now, built });
+    } else {
+        auto& timing = (*it).value;
+        if (timing.built)
+            return;
+        timing.end_ms = now;
+        timing.built = built;
+    }
+
+    if (built)
+        ++m_targets_built;
+}
+
+void BuildMonitor::draw_status(bool force)
+{
+    u64 now = now_ms();
+    if (!m_at_line_start || (!force && now - m_last_frame_ms < s_frame_interval_ms))
+        return;
+    m_last_frame_ms = now;
+
+    u64 elapsed_ms = now - m_start_ms;
+    char progress[128] = "";
+    int length = 0;
+    if (m_steps_total)
+        length += snprintf(progress + length, sizeof(progress) - length, " [%u/%u]", m_steps_done, m_steps_total);
+    else if (m_progress)
+        length += snprintf(progress + length, sizeof(progress) - length, " [%3u%%]", m_progress / 10);
+
+    if (elapsed_ms >= 1000) {
+        if (m_steps_total) {
+            u32 steps_per_second = (u64)m_steps_done * 10000 / elapsed_ms;
+            length += snprintf(progress + length, sizeof(progress) - length, " %u.%u steps/s", steps_per_second / 10, steps_per_second % 10);
+        } else if (m_targets_built) {
+            u32 targets_per_minute = (u64)m_targets_built * 600000 / elapsed_ms;
+            length += snprintf(progress + length, sizeof(progress) - length, " %u targets, %u.%u/min", m_targets_built, targets_per_minute / 10, targets_per_minute % 10);
+        }
+    }
+
+    if (m_progress && m_progress < 1000) {
+        u32 eta = elapsed_ms * (1000 - m_progress) / m_progress / 1000;
+        snprintf(progress + length, sizeof(progress) - length, " ETA %u:%02u", eta / 60, eta % 60);
+    }
+
+    static const char chars[4] = { '-', '\\', '|', '/' };
+    u32 elapsed = elapsed_ms / 1000;
+    fprintf(stdout, "\r\033[K%c %u:%02u%s", chars[m_frame++ % 4], elapsed / 60, elapsed % 60, progress);
+    fflush(stdout);
+    m_status_visible = true;
+}
+
+void BuildMonitor::clear_status()
+{
+    if (!m_status_visible)
+        return;
+    fputs("\r\033[K", stdout);
+    fflush(stdout);
+    m_status_visible = false;
+}
+
+void BuildMonitor::write_report() const
+{
+    struct ReportLine {
+        const String* target;
+        u64 duration_ms;
+    };
+
+    Vector<ReportLine> lines;
+    for (auto& it : m_targets)
+        lines.append({ &it.key, it.value.end_ms - it.value.start_ms });
+    quick_sort(lines.begin(), lines.end(), [](auto& a, auto& b) {
+        if (a.duration_ms != b.duration_ms)
+            return a.duration_ms > b.duration_ms;
+        return strcmp(a.target->characters(), b.target->characters()) < 0;
+    });
+
+    FILE* file = fopen(m_report_filename.characters(), "w");
+    if (!file) {
+        fprintf(stderr, "Could not write build report %s: %s\n", m_report_filename.characters(), strerror(errno));
+        return;
+    }
+
+    u64 total_ms = now_ms() - m_start_ms;
+    fprintf(file, "# wall time per target, from its first to its last line of build output\n");
+    fprintf(file, "# %u targets, build took %u.%03us\n", (u32)lines.size(), (u32)(total_ms / 1000), (u32)(total_ms % 1000));
+    for (auto& line : lines)
+        fprintf(file, "%8u.%03us  %s\n", (u32)(line.duration_ms / 1000), (u32)(line.duration_ms % 1000), line.target->characters());
+    fclose(file);
+
+    fprintf(stdout, "Build times per target written to %s\n", m_report_filename.characters());
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <stdio.h>
+
+// Runs a shell command and animates a status line while it is running. The output of
+// the command is read through pipes in the same process, so nothing spins while the
+// command is busy and no state is shared through the file system.
+// Progress lines of make ("[ 45%] ...") and ninja ("[12/345] ...") are parsed for the
+// status line, and the time spent in every CMake target is recorded.
+class BuildMonitor {
+public:
+    explicit BuildMonitor(bool suppress_output);
+
+    // returns the exit status of the command, or -1 if it could not be started
+    int run(const String& command);
+
+    // file to write the per target durations to, after the command finished
+    void set_report_filename(const String& filename) { m_report_filename = filename; }
+
+private:
+    struct Stream {
+        int fd;
+        FILE* output;
+        bool open;
+        Vector<char, 256> line;
+    };
+
+    void handle_output(Stream&, const char* data, size_t size);
+    void handle_line(const StringView& line);
+    void update_target(const StringView& target, bool built);
+    void draw_status(bool force);
+    void clear_status();
+    void write_report() const;
+
+    bool m_suppress_output;
+    bool m_interactive;
+    bool m_status_visible { false };
+    bool m_at_line_start { true };
+    u64 m_start_ms { 0 };
+    u64 m_last_frame_ms { 0 };
+    u32 m_frame { 0 };
+
+    // progress of the build in permille, from make percentages or ninja steps
+    u32 m_progress { 0 };
+    u32 m_steps_done { 0 };
+    u32 m_steps_total { 0 };
+    u32 m_targets_built { 0 };
+
+    struct TargetTiming {
+        u64 start_ms;
+        u64 end_ms;
+        bool built;
+    };
+    HashMap<String, TargetTiming> m_targets;
+    String m_report_filename;
+
+    // tail of the suppressed output, shown if the command fails
+    Vector<String> m_recent_lines;
+};
@@ -1,11 +1,18 @@
 #include "CMakeGenerator.h"
 #include "DependencyResolver.h"
 #include "FileProvider.h"
+#include "GenerationStamp.h"
 #include "PackageDB.h"
+#include "Profiler.h"
 #include "SettingsProvider.h"
+#include "ToolchainDB.h"
 #include "StringUtils.h"
 #include <AK/FileSystemPath.h>
+#include <AK/QuickSort.h>
+#include <LibCore/File.h>
+#include <string.h>
 #include <string>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 CMakeGenerator::CMakeGenerator()
@@ -22,13 +29,203 @@ CMakeGenerator& CMakeGenerator::the()
     if (!s_the) {
         s_the = &CMakeGenerator::construct().leak_ref();
 
-        auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
+        auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
         if (!gen_path.is_empty())
             create_dir(gen_path);
     }
     return *s_the;
 }
 
+static u64 hash_value(u64 value, u64 hash)
+{
+    return fnv1a_hash(StringView((const char*)&value, sizeof(value)), hash);
+}
+
+static String gendata_subdirectory(const char* kind, const String& machine, const String& name)
+{
+    StringBuilder builder;
+    builder.append(SettingsProvider::the().gendata_directory().value_or(""));
+    builder.appendf("/%s", kind);
+    if (!machine.is_empty())
+        builder.appendf("/%s", machine.characters());
+    if (!name.is_empty())
+        builder.appendf("/%s", name.characters());
+    return builder.build();
+}
+
+u64 CMakeGenerator::file_input_hash(const String& filename)
+{
+    auto it = m_file_hashes.find(filename);
+    if (it != m_file_hashes.end())
+        return (*it).value;
+    u64 hash = fnv1a_hash(filename, FileProvider::the().hash_file(filename));
+    m_file_hashes.set(filename, hash);
+    return hash;
+}
+
+// inputs of all generated files: the meta binary, the settings and the configured toolchain
+u64 CMakeGenerator::global_input_hash()
+{
+    if (m_global_input_hash.has_value())
+        return m_global_input_hash.value();
+
+    auto& settings = SettingsProvider::the();
+    u64 hash = GenerationStamp::meta_version();
+    hash = fnv1a_hash(settings.root().value_or(""), hash);
+    hash = fnv1a_hash(settings.build_directory().value_or(""), hash);
+    hash = fnv1a_hash(settings.gendata_directory().value_or(""), hash);
+    hash = fnv1a_hash(settings.build_configuration().to_string(), hash);
+    hash = fnv1a_hash(settings.generator_configuration().to_string(), hash);
+
+    auto toolchain_name = settings.toolchain().value_or("default");
+    hash = fnv1a_hash(toolchain_name, hash);
+    if (auto* toolchain = ToolchainDB::the().get(toolchain_name))
+        hash = hash_value(file_input_hash(toolchain->filename()), hash);
+
+    m_global_input_hash = hash;
+    return hash;
+}
+
+// The generated files of a package depend on its definition, the definitions of the
+// packages it depends on and the files found by its globs.
+u64 CMakeGenerator::package_input_hash(const Package& package)
+{
+    auto it = m_package_input_hashes.find(package.id());
+    if (it != m_package_input_hashes.end())
+        return (*it).value;
+
+    u64 hash = hash_value(global_input_hash(), fnv1a_hash(package.machine_name()));
+    auto add_definition = [&](const Package& definition) {
+        hash = fnv1a_hash(definition.name(), hash);
+        hash = hash_value(file_input_hash(definition.filename()), hash);
+    };
+    add_definition(package);
+    auto node = DependencyResolver::the().get_dependency_tree(package);
+    DependencyNode::start_by_leave(node, add_definition);
+
+    auto add_paths = [&](const Vector<PathId>& paths) {
+        hash = hash_value(paths.size(), hash);
+        for (auto id : paths)
+            hash = fnv1a_hash(PathStore::the().path(id), hash);
+    };
+    add_paths(package.sources());
+    add_paths(package.includes());
+    add_paths(package.unity_build_exclude());
+
+    // automatic precompiled headers are picked from the content of the sources
+    if (package.precompiled_headers_auto()) {
+        for (auto id : package.sources()) {
+            struct stat st;
+            if (stat(PathStore::the().path(id).characters(), &st) < 0)
+                continue;
+            hash = hash_value(st.st_mtim.tv_sec, hash);
+            hash = hash_value(st.st_mtim.tv_nsec, hash);
+            hash = hash_value(st.st_size, hash);
+        }
+    }
+
+    m_package_input_hashes.set(package.id(), hash);
+    return hash;
+}
+
+bool CMakeGenerator::is_up_to_date(const GenerationStamp& stamp)
+{
+    // packages shared by several images or dependency trees are handled once per run
+    if (m_handled_stamps.contains(stamp.filename()))
+        return true;
+    if (!m_only_stale || !stamp.is_current())
+        return false;
+    m_handled_stamps.set(stamp.filename());
+    ++m_up_to_date_count;
+    return true;
+}
+
+bool CMakeGenerator::write_stamp(const GenerationStamp& stamp)
+{
+    m_handled_stamps.set(stamp.filename());
+    ++m_generated_count;
+    return stamp.write();
+}
+
+bool CMakeGenerator::gen_image(const Image& image, const Vector<const Package*> packages)
+{
+    ProfileScope scope("gen_image", image.name());
+    u64 hash = fnv1a_hash(image.name(), global_input_hash());
+    hash = hash_value(file_input_hash(image.filename()), hash);
+    for (auto* package : packages)
+        hash = hash_value(package_input_hash(*package), hash);
+
+    GenerationStamp stamp(gendata_subdirectory("Image", {}, image.name()), hash);
+    if (is_up_to_date(stamp)) {
+        // the packages of the image are still checked one by one
+        for (auto* package : packages)
+            gen_package(*package);
+        return true;
+    }
+    if (!write_image(image, packages))
+        return false;
+    return write_stamp(stamp);
+}
+
+bool CMakeGenerator::gen_package(const Package& package)
+{
+    ProfileScope scope("gen_package", package.name());
+    GenerationStamp stamp(gendata_subdirectory("Package", package.machine_name(), package.name()), package_input_hash(package));
+    if (is_up_to_date(stamp))
+        return true;
+    if (!write_package(package))
+        return false;
+    return write_stamp(stamp);
+}
+
+bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<String>& json_input_files)
+{
+    ProfileScope scope("gen_toolchain");
+    // the toolchain projects build all build and host packages
+    u64 hash = hash_value(file_input_hash(toolchain.filename()), global_input_hash());
+    for (auto& filename : json_input_files)
+        hash = fnv1a_hash(filename, hash);
+    BuildPackageDB::the().for_each_entry([&](auto&, auto& package) {
+        hash = hash_value(package_input_hash(package), hash);
+        return IterationDecision::Continue;
+    });
+    HostPackageDB::the().for_each_entry([&](auto&, auto& package) {
+        hash = hash_value(package_input_hash(package), hash);
+        return IterationDecision::Continue;
+    });
+    // the target packages only affect the toolchain by their memory weight
+    hash = hash_value(TargetPackageDB::the().max_memory_weight(), hash);
+
+    auto toolchain_directory = gendata_subdirectory("Toolchain", {}, {});
+    GenerationStamp stamp(toolchain_directory, hash);
+    if (is_up_to_date(stamp)) {
+        // the build runs meta whenever a meta json file is newer than this file
+        StringBuilder depend_filename;
+        depend_filename.appendf("%s/meta_json_files.depend", toolchain_directory.characters());
+        utimensat(AT_FDCWD, depend_filename.build().characters(), nullptr, 0);
+        return true;
+    }
+    if (!write_toolchain(toolchain, json_input_files))
+        return false;
+    return write_stamp(stamp);
+}
+
+bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
+{
+    ProfileScope scope("gen_root");
+    u64 hash = hash_value(file_input_hash(toolchain.filename()), global_input_hash());
+    hash = fnv1a_hash(FileProvider::the().current_dir(), hash);
+    for (int i = 0; i < argc; ++i)
+        hash = fnv1a_hash(argv[i], hash);
+
+    GenerationStamp stamp(SettingsProvider::the().gendata_directory().value_or(""), hash);
+    if (is_up_to_date(stamp))
+        return true;
+    if (!write_root(toolchain, argc, argv))
+        return false;
+    return write_stamp(stamp);
+}
+
 const String CMakeGenerator::gen_header() const
 {
     return "# - THIS FILE HAS BEEN GENERATED - DO NOT EDIT\n# - To regenerate, please use the meta tool.\n\n";
@@ -45,7 +242,7 @@ const String CMakeGenerator::project_root_dir() const
     if (s_project_root_dir.is_empty()) {
         StringBuilder builder;
         builder.append("set(PROJECT_ROOT_DIR \"");
-        builder.append(SettingsProvider::the().get_string("root").value_or(""));
+        builder.append(SettingsProvider::the().root().value_or(""));
         builder.append("\")\n\n");
         s_project_root_dir = builder.build();
     }
@@ -99,6 +296,113 @@ const String CMakeGenerator::includes() const
     return s_includes;
 }
 
+JsonValue CMakeGenerator::generator_option(const String& key) const
+{
+    return SettingsProvider::the().generator_configuration().get(key);
+}
+
+bool CMakeGenerator::single_configure() const
+{
+    auto value = generator_option("single_configure");
+    return value.is_bool() && value.as_bool();
+}
+
+u32 CMakeGenerator::unity_build_batch_size(const Package& package) const
+{
+    if (package.unity_build_batch_size().has_value())
+        return package.unity_build_batch_size().value();
+
+    auto value = generator_option("unity_build_batch_size");
+    if (value.is_u32())
+        return value.as_u32();
+    return 0;
+}
+
+bool CMakeGenerator::is_unity_build_source(const Package& package, PathId source_id, const String& source) const
+{
+    if (!source.ends_with(".cpp") && !source.ends_with(".cc") && !source.ends_with(".cxx"))
+        return false;
+
+    // generated sources might not exist yet when the unity files are written
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
+    if (!gen_path.is_empty() && source.starts_with(gen_path))
+        return false;
+
+    return !package.unity_build_exclude().contains_slow(source_id);
+}
+
+static String parse_system_include(const StringView& line)
+{
+    size_t i = 0;
+    auto skip_whitespace = [&] {
+        while (i < line.length() && (line[i] == ' ' || line[i] == '\t'))
+            ++i;
+    };
+
+    skip_whitespace();
+    if (i >= line.length() || line[i] != '#')
+        return {};
+    ++i;
+    skip_whitespace();
+    if (!line.substring_view(i, line.length() - i).starts_with("include"))
+        return {};
+    i += 7;
+    skip_whitespace();
+    if (i >= line.length() || line[i] != '<')
+        return {};
+
+    size_t start = i;
+    while (i < line.length() && line[i] != '>')
+        ++i;
+    if (i >= line.length())
+        return {};
+    return String { line.substring_view(start, i - start + 1) };
+}
+
+Vector<String> CMakeGenerator::most_included_headers(const Package& package, u32 count) const
+{
+    // Only headers included with angle brackets are considered, as they are resolved by the include directories
+    // of the package and not relative to the including source file.
+    HashMap<String, u32> include_count;
+    for (auto source : package.sources()) {
+        auto file = Core::File::construct(PathStore::the().path(source));
+        if (!file->open(Core::IODevice::ReadOnly))
+            continue;
+
+        auto content = file->read_all();
+        StringView view { (const char*)content.data(), content.size() };
+        for (auto& line : view.split_view('\n')) {
+            auto header = parse_system_include(line);
+            if (!header.is_empty())
+                include_count.set(header, include_count.get(header).value_or(0) + 1);
+        }
+    }
+
+    struct HeaderCount {
+        String header;
+        u32 count;
+    };
+    Vector<HeaderCount> header_counts;
+    for (auto& it : include_count) {
+        // a header included by a single translation unit does not benefit from precompilation
+        if (it.value > 1)
+            header_counts.append({ it.key, it.value });
+    }
+    quick_sort(header_counts.begin(), header_counts.end(), [](auto& a, auto& b) {
+        if (a.count != b.count)
+            return a.count > b.count;
+        return strcmp(a.header.characters(), b.header.characters()) < 0;
+    });
+
+    Vector<String> headers;
+    for (auto& header_count : header_counts) {
+        if (headers.size() >= count)
+            break;
+        headers.append(header_count.header);
+    }
+    return headers;
+}
+
 String get_target_name(const String& name)
 {
     String ret = name;
@@ -109,9 +413,9 @@ String get_target_name(const String& name)
     return ret;
 }
 
-bool CMakeGenerator::gen_image(const Image& image, const Vector<const Package*> packages)
+bool CMakeGenerator::write_image(const Image& image, const Vector<const Package*> packages)
 {
-    auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
 
     if (gen_path.is_empty()) {
         return false;
@@ -140,7 +444,8 @@ bool CMakeGenerator::gen_image(const Image& image, const Vector<const Package*>
     cmakelists_txt.append(image.name());
     cmakelists_txt.append(" C CXX ASM)\n\n");
     cmakelists_txt.appendf("set(META_BUILD_IMAGE %s)\n\n", image.name().characters());
-    cmakelists_txt.append("include(${CMAKE_CURRENT_LIST_DIR}/../../Toolchain/Host/tools.cmake)\n\n");
+    cmakelists_txt.append("include(${CMAKE_CURRENT_LIST_DIR}/../../Toolchain/Host/tools.cmake)\n");
+    cmakelists_txt.append("set(META_RUN_GENERATOR ${CMAKE_CURRENT_LIST_DIR}/../../Toolchain/run_generator.cmake)\n\n");
 
     cmakelists_txt.append(make_command_workaround());
     cmakelists_txt.append(includes());
@@ -152,7 +457,8 @@ bool CMakeGenerator::gen_image(const Image& image, const Vector<const Package*>
     cmakelists_txt.append("\" CACHE INTERNAL \"\" FORCE)");
     cmakelists_txt.append("\n");
 
-    for (auto& installDir : image.install_dirs()) {
+    for (auto* installDir_entry : sorted_entries(image.install_dirs())) {
+        auto& installDir = *installDir_entry;
         cmakelists_txt.append("set(CMAKE_INSTALL_");
         cmakelists_txt.append(image.install_dir_to_string(installDir.key).to_uppercase());
         cmakelists_txt.append(" ");
@@ -162,7 +468,7 @@ bool CMakeGenerator::gen_image(const Image& image, const Vector<const Package*>
     cmakelists_txt.append("\n");
 
     cmakelists_txt.append("include_directories(");
-    cmakelists_txt.append(SettingsProvider::the().get_string("gendata_directory").value_or(""));
+    cmakelists_txt.append(SettingsProvider::the().gendata_directory().value_or(""));
     cmakelists_txt.append("/Package/Target)\n\n");
 
     for (auto& package : packages) {
@@ -256,9 +562,9 @@ String CMakeGenerator::gen_package_collection(const Package& package)
 
     if (package.dependencies().size()) {
         for (auto& dependency : package.dependencies()) {
-            if (dependency.value == LinkageType::Direct || dependency.value == LinkageType::HeaderOnly)
+            if (dependency.linkage == LinkageType::Direct || dependency.linkage == LinkageType::HeaderOnly)
                 continue;
-            depends_builder.append(dependency.key);
+            depends_builder.append(dependency.name);
             depends_builder.append(" ");
         }
     }
@@ -396,23 +702,61 @@ String CMakeGenerator::gen_package_collection(const Package& package)
     return package_collection.build();
 }
 
+void CMakeGenerator::build_path_templates()
+{
+    auto add_prefix = [&](String prefix, const String& replacement) {
+        while (prefix.length() > 1 && prefix.ends_with("/"))
+            prefix = prefix.substring(0, prefix.length() - 1);
+        m_path_prefixes.append({ prefix, replacement });
+    };
+
+    add_prefix(SettingsProvider::the().gendata_directory().value_or("${package_gendata}"), "${CMAKE_CURRENT_LIST_DIR}");
+    add_prefix(SettingsProvider::the().root().value_or("${root}"), "${PROJECT_ROOT_DIR}");
+
+    // longest prefix first, the gendata directory usually lives within root
+    quick_sort(m_path_prefixes.begin(), m_path_prefixes.end(), [](auto& a, auto& b) {
+        return a.prefix.length() > b.prefix.length();
+    });
+
+    m_cmake_variables.set("root", "${PROJECT_ROOT_DIR}");
+    m_cmake_variables.set("package_gendata", "${CMAKE_CURRENT_LIST_DIR}/${META_BUILD_IMAGE}");
+    m_cmake_variables.set("host_sysroot", "${CMAKE_SYSROOT}");
+    m_cmake_variables.set("image", "${META_BUILD_IMAGE}");
+
+    m_path_templates_built = true;
+}
+
 String CMakeGenerator::make_path_with_cmake_variables(const String& path)
 {
+    if (!m_path_templates_built)
+        build_path_templates();
+
     String path_replaced = path;
 
-    path_replaced = replace(path_replaced, SettingsProvider::the().get_string("gendata_directory").value_or("${package_gendata}"), "${CMAKE_CURRENT_LIST_DIR}");
-    path_replaced = replace(path_replaced, SettingsProvider::the().get_string("root").value_or("${root}"), "${PROJECT_ROOT_DIR}");
-    path_replaced = replace_variables(path_replaced, "root", "${PROJECT_ROOT_DIR}");
-    path_replaced = replace_variables(path_replaced, "package_gendata", "${CMAKE_CURRENT_LIST_DIR}/${META_BUILD_IMAGE}");
-    path_replaced = replace_variables(path_replaced, "host_sysroot", "${CMAKE_SYSROOT}");
-    path_replaced = replace_variables(path_replaced, "image", "${META_BUILD_IMAGE}");
+    for (auto& path_prefix : m_path_prefixes) {
+        auto& prefix = path_prefix.prefix;
+        if (path.length() < prefix.length() || memcmp(path.characters(), prefix.characters(), prefix.length()))
+            continue;
+        // only match whole path components
+        if (path.length() > prefix.length() && path[prefix.length()] != '/' && !prefix.ends_with("/"))
+            continue;
+
+        StringBuilder builder;
+        builder.append(path_prefix.replacement);
+        builder.append(path.substring_view(prefix.length(), path.length() - prefix.length()));
+        path_replaced = builder.build();
+        break;
+    }
+
+    if (!potentially_contains_variable(path_replaced))
+        return path_replaced;
 
-    return path_replaced;
+    return expand_variables(path_replaced, m_cmake_variables);
 }
 
 bool CMakeGenerator::gen_test_executable(const Package& package, const TestExecutable& test_executable)
 {
-    auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
 
     if (gen_path.is_empty()) {
         fprintf(stderr, "Empty gen path, check configuration!\n");
@@ -474,12 +818,13 @@ bool CMakeGenerator::gen_test_executable(const Package& package, const TestExecu
     cmakelists_txt.append(")\n");
 
     cmakelists_txt.append("set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS\n    ");
-    cmakelists_txt.join("\n    ", directories_to_watch);
+    cmakelists_txt.join("\n    ", sorted_strings(directories_to_watch));
     cmakelists_txt.append(")\n\n");
 
     // dependencies
     cmakelists_txt.append("set(STATIC_LINK_LIBRARIES\n");
-    for (auto& dependency : test_executable.dependency()) {
+    for (auto* dependency_entry : sorted_entries(test_executable.dependency())) {
+        auto& dependency = *dependency_entry;
         if (package.get_dependency_linkage(dependency.value) == LinkageType::Static) {
             cmakelists_txt.append("    \"");
             cmakelists_txt.append(dependency.key);
@@ -489,7 +834,8 @@ bool CMakeGenerator::gen_test_executable(const Package& package, const TestExecu
     }
     cmakelists_txt.append(")\n");
 
-    for (auto& dependency : test_executable.dependency()) {
+    for (auto* dependency_entry : sorted_entries(test_executable.dependency())) {
+        auto& dependency = *dependency_entry;
         if (package.get_dependency_linkage(dependency.value) == LinkageType::Direct) {
             cmakelists_txt.append("include(../../../");
             cmakelists_txt.append(dependency.key);
@@ -524,7 +870,7 @@ bool CMakeGenerator::gen_test_executable(const Package& package, const TestExecu
     cmakelists_txt.append("\n");
 
     // symlink res folder into build folder, if existent
-    for (auto& dir : directories_to_watch) {
+    for (auto& dir : sorted_strings(directories_to_watch)) {
         cmakelists_txt.appendf("if(EXISTS %s/resource)\n", dir.characters());
         cmakelists_txt.appendf("    execute_process(COMMAND ln -sf %s/resource ${CMAKE_CURRENT_BINARY_DIR})\n", dir.characters());
         cmakelists_txt.append("endif()\n\n");
@@ -570,7 +916,7 @@ bool CMakeGenerator::gen_test_executable(const Package& package, const TestExecu
     return true;
 }
 
-bool CMakeGenerator::gen_package(const Package& package)
+bool CMakeGenerator::write_package(const Package& package)
 {
     /**
      * This generates CMakeLists.txt for a package
@@ -600,7 +946,7 @@ bool CMakeGenerator::gen_package(const Package& package)
      * 
      */
 
-    auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
 
     if (gen_path.is_empty()) {
         fprintf(stderr, "Empty gen path, check configuration!\n");
@@ -631,45 +977,69 @@ bool CMakeGenerator::gen_package(const Package& package)
 
     if (package.type() == PackageType::Library || package.type() == PackageType::Executable) {
 
-        HashTable<String> directories_to_watch;
+        HashTable<PathId> directories_to_watch;
+
+        // unity build: C++ sources are batched into groups, each group is compiled as one translation unit
+        auto batch_size = unity_build_batch_size(package);
+        Vector<Vector<String>> unity_groups;
 
         // sources
         cmakelists_txt.append("set(SOURCES\n");
-        for (auto& source : package.sources()) {
+        for (auto source_id : package.sources()) {
+            auto source = PathStore::the().path(source_id);
+            directories_to_watch.set(PathStore::the().parent(source_id));
+
+            if (batch_size > 1 && is_unity_build_source(package, source_id, source)) {
+                if (unity_groups.is_empty() || unity_groups.last().size() >= batch_size)
+                    unity_groups.append(Vector<String>());
+                unity_groups.last().append(make_path_with_cmake_variables(source));
+                continue;
+            }
+
             cmakelists_txt.append("    \"");
             cmakelists_txt.append(make_path_with_cmake_variables(source));
             cmakelists_txt.append("\"");
             cmakelists_txt.append("\n");
-
-            FileSystemPath path { source };
-            directories_to_watch.set(make_path_with_cmake_variables(path.dirname()));
         }
+        for (size_t i = 0; i < unity_groups.size(); ++i)
+            cmakelists_txt.appendf("    \"${CMAKE_CURRENT_BINARY_DIR}/unity_%u.cpp\"\n", (u32)i);
         cmakelists_txt.append(")\n");
 
+        // file(GENERATE) only touches the unity files when their content changes
+        for (size_t i = 0; i < unity_groups.size(); ++i) {
+            cmakelists_txt.appendf("file(GENERATE OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/unity_%u.cpp CONTENT\n\"", (u32)i);
+            for (auto& source : unity_groups[i])
+                cmakelists_txt.appendf("#include \\\"%s\\\"\n", source.characters());
+            cmakelists_txt.append("\")\n");
+            cmakelists_txt.appendf("set_source_files_properties(${CMAKE_CURRENT_BINARY_DIR}/unity_%u.cpp PROPERTIES GENERATED TRUE)\n", (u32)i);
+        }
+
         // includes
         cmakelists_txt.append("set(INCLUDE_DIRS\n");
-        for (auto& include : package.includes()) {
+        for (auto include : package.includes()) {
             cmakelists_txt.append("    \"");
-            cmakelists_txt.append(make_path_with_cmake_variables(include));
+            cmakelists_txt.append(make_path_with_cmake_variables(PathStore::the().path(include)));
 
             cmakelists_txt.append("\"");
             cmakelists_txt.append("\n");
 
-            FileSystemPath path { include };
-            directories_to_watch.set(make_path_with_cmake_variables(path.dirname()));
+            directories_to_watch.set(PathStore::the().parent(PathStore::the().without_trailing_slash(include)));
         }
         cmakelists_txt.append(")\n");
 
+        HashTable<String> watched_directories;
+        for (auto directory : directories_to_watch)
+            watched_directories.set(make_path_with_cmake_variables(PathStore::the().path(directory)));
         cmakelists_txt.append("set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS\n");
-        cmakelists_txt.join("\n    ", directories_to_watch);
+        cmakelists_txt.join("\n    ", sorted_strings(watched_directories));
         cmakelists_txt.append(")\n\n");
 
         // dependencies
         cmakelists_txt.append("set(STATIC_LINK_LIBRARIES\n");
         for (auto& dependency : package.dependencies()) {
-            if (package.get_dependency_linkage(dependency.value) == LinkageType::Static) {
+            if (package.get_dependency_linkage(dependency.linkage) == LinkageType::Static) {
                 cmakelists_txt.append("    \"");
-                cmakelists_txt.append(dependency.key);
+                cmakelists_txt.append(dependency.name);
                 cmakelists_txt.append("\"");
                 cmakelists_txt.append("\n");
             }
@@ -677,9 +1047,9 @@ bool CMakeGenerator::gen_package(const Package& package)
         cmakelists_txt.append(")\n");
 
         for (auto& dependency : package.dependencies()) {
-            if (package.get_dependency_linkage(dependency.value) == LinkageType::Direct) {
+            if (package.get_dependency_linkage(dependency.linkage) == LinkageType::Direct) {
                 cmakelists_txt.append("include(../");
-                cmakelists_txt.append(dependency.key);
+                cmakelists_txt.append(dependency.name);
                 cmakelists_txt.append("/direct_linkage.include)\n");
             }
         }
@@ -687,9 +1057,9 @@ bool CMakeGenerator::gen_package(const Package& package)
 
         //        cmakelists_txt.append("set(INTERFACE_LINK_LIBRARIES\n");
         //        for (auto& dependency : package.dependencies()) {
-        //            if (package.get_dependency_linkage(dependency.value) == LinkageType::HeaderOnly) {
+        //            if (package.get_dependency_linkage(dependency.linkage) == LinkageType::HeaderOnly) {
         //                cmakelists_txt.append("    \"");
-        //                cmakelists_txt.append(get_target_name(dependency.key));
+        //                cmakelists_txt.append(get_target_name(dependency.name));
         //                cmakelists_txt.append("\"");
         //                cmakelists_txt.append("\n");
         //            }
@@ -713,6 +1083,35 @@ bool CMakeGenerator::gen_package(const Package& package)
         cmakelists_txt.append(" PUBLIC ${STATIC_LINK_LIBRARIES})\n");
         cmakelists_txt.append("\n");
 
+        // memory heavy packages use the heavy job pools of the toolchain (Ninja only)
+        if (package.memory_weight() > 1) {
+            cmakelists_txt.append("if(META_HEAVY_JOB_POOLS)\n");
+            cmakelists_txt.appendf("    set_target_properties(%s PROPERTIES JOB_POOL_COMPILE meta_compile_heavy JOB_POOL_LINK meta_link_heavy)\n",
+                targetName.characters());
+            cmakelists_txt.append("endif()\n\n");
+        }
+
+        auto precompiled_headers = package.precompiled_headers();
+        if (package.precompiled_headers_auto())
+            precompiled_headers.append(most_included_headers(package, package.precompiled_headers_auto()));
+
+        if (precompiled_headers.size()) {
+            // target_precompile_headers is available since CMake 3.16, C sources of the target are not affected
+            cmakelists_txt.append("if(COMMAND target_precompile_headers)\n");
+            cmakelists_txt.appendf("    target_precompile_headers(%s PRIVATE\n", targetName.characters());
+            for (auto& header : precompiled_headers) {
+                if (header.starts_with("<")) {
+                    // the closing angle bracket has to be escaped within the generator expression
+                    auto header_without_closing_bracket = header.substring(0, header.length() - 1);
+                    cmakelists_txt.appendf("        \"$<$<COMPILE_LANGUAGE:CXX>:%s$<ANGLE-R>>\"\n", header_without_closing_bracket.characters());
+                } else {
+                    cmakelists_txt.appendf("        \"$<$<COMPILE_LANGUAGE:CXX>:%s>\"\n", make_path_with_cmake_variables(header).characters());
+                }
+            }
+            cmakelists_txt.append("    )\n");
+            cmakelists_txt.append("endif()\n\n");
+        }
+
         //        cmakelists_txt.append("target_link_libraries(");
         //        cmakelists_txt.append(targetName);
         //        cmakelists_txt.append(" INTERFACE ${INTERFACE_LINK_LIBRARIES})\n");
@@ -724,10 +1123,12 @@ bool CMakeGenerator::gen_package(const Package& package)
         //       from CMake 3.13 it is possible also to use: target_link_options(<target> [BEFORE] <INTERFACE|PUBLIC|PRIVATE> [items1...] ... )
 
         if (package.host_tools().size()) {
-            for (auto& tool : package.host_tools()) {
+            for (auto* tool_entry : sorted_entries(package.host_tools())) {
+                auto& tool = *tool_entry;
                 if (tool.key == "cxx") {
                     if (tool.value.execution_result_definitions.size()) {
-                        for (auto& definition : tool.value.execution_result_definitions) {
+                        for (auto* definition_entry : sorted_entries(tool.value.execution_result_definitions)) {
+                            auto& definition = *definition_entry;
                             cmakelists_txt.append("execute_process(\n");
                             cmakelists_txt.append("    COMMAND ");
                             cmakelists_txt.append(definition.value);
@@ -918,7 +1319,7 @@ bool CMakeGenerator::gen_package(const Package& package)
 #endif
 
                 cmakelists_txt.append("set(LIBNAME \"");
-                cmakelists_txt.append(replace(deployment.ptr()->name(), "\\.", ""));
+                cmakelists_txt.append(replace(deployment.ptr()->name(), ".", ""));
                 cmakelists_txt.append("\")\n");
                 cmakelists_txt.append("add_library(${LIBNAME} STATIC ");
                 cmakelists_txt.append(make_path_with_cmake_variables(deployment.ptr()->source()));
@@ -946,22 +1347,17 @@ bool CMakeGenerator::gen_package(const Package& package)
         }
     }
 
-    for (auto& generator : package.run_generators()) {
+    for (auto* generator_entry : sorted_entries(package.run_generators())) {
+        auto& generator = *generator_entry;
         cmakelists_txt.append("# Generator: ");
         cmakelists_txt.append(generator.key);
         cmakelists_txt.append("\n");
 
         Vector<String> output_dirs;
-        cmakelists_txt.append("set(OUTPUT_FILES\n");
         for (auto& tuple : generator.value.input_output_tuples) {
-            cmakelists_txt.append("    \"");
-            cmakelists_txt.append(make_path_with_cmake_variables(tuple.output));
-            cmakelists_txt.append("\"\n");
-
             AK::FileSystemPath path(tuple.output);
             output_dirs.append(make_path_with_cmake_variables(path.dirname()));
         }
-        cmakelists_txt.append(")\n");
 
         StringBuilder dirs_str;
         dirs_str.join("\n    ", output_dirs);
@@ -975,7 +1371,7 @@ bool CMakeGenerator::gen_package(const Package& package)
         cmakelists_txt.append(" ");
         cmakelists_txt.append(generator.key);
         cmakelists_txt.append(" PATHS \"");
-        cmakelists_txt.append(SettingsProvider::the().get_string("build_directory").value_or(""));
+        cmakelists_txt.append(SettingsProvider::the().build_directory().value_or(""));
         cmakelists_txt.append("/Sysroots");
         cmakelists_txt.append("\")\n");
         cmakelists_txt.append("if(NOT ");
@@ -983,34 +1379,47 @@ bool CMakeGenerator::gen_package(const Package& package)
         cmakelists_txt.append(")\n    message(FATAL_ERROR \"Did not find generator ");
         cmakelists_txt.append(generator.key);
         cmakelists_txt.append("\")\nendif()\n");
-        cmakelists_txt.append("add_custom_command(OUTPUT ${OUTPUT_FILES}\n");
+
+        // one command per tuple, so independent generator runs are scheduled concurrently.
+        // The command output is a stamp holding the content hash, the generated file is only
+        // replaced by run_generator.cmake if its content changed. Make does not rebuild missing
+        // byproducts, the stamps of deleted outputs are removed before the stamps are checked.
+        cmakelists_txt.append("set(OUTPUT_STAMPS)\n");
+        cmakelists_txt.append("set(OUTPUT_FILES)\n");
         for (auto& tuple : generator.value.input_output_tuples) {
-            cmakelists_txt.append("    COMMAND ${");
-            cmakelists_txt.append(generator.key);
-            cmakelists_txt.append("} ");
-            cmakelists_txt.append(tuple.flags);
-            cmakelists_txt.append(" ");
-            cmakelists_txt.append(make_path_with_cmake_variables(tuple.input));
+            auto input = make_path_with_cmake_variables(tuple.input);
+            auto output = make_path_with_cmake_variables(tuple.output);
+            cmakelists_txt.appendf("add_custom_command(OUTPUT \"%s.meta-hash\"\n", output.characters());
+            cmakelists_txt.appendf("    BYPRODUCTS \"%s\"\n", output.characters());
             // Fixme: for now, we only accept generators that put the output to stdout. Has to be configurable...
-            cmakelists_txt.append(" > ");
-            cmakelists_txt.append(make_path_with_cmake_variables(tuple.output));
-            cmakelists_txt.append("\n");
+            cmakelists_txt.appendf("    COMMAND ${CMAKE_COMMAND} \"-DGENERATOR=${%s}\" \"-DFLAGS=%s\"", generator.key.characters(), tuple.flags.characters());
+            cmakelists_txt.appendf(" \"-DINPUT=%s\" \"-DOUTPUT=%s\" -P ${META_RUN_GENERATOR}\n", input.characters(), output.characters());
+            cmakelists_txt.appendf("    DEPENDS ${%s} \"%s\" ${META_RUN_GENERATOR}\n", generator.key.characters(), input.characters());
+            cmakelists_txt.append("    COMMENT \"Executing ");
+            cmakelists_txt.append(generator.key);
+            cmakelists_txt.append(" for target ");
+            cmakelists_txt.append(targetName);
+            cmakelists_txt.append(": ");
+            cmakelists_txt.append(AK::FileSystemPath(tuple.input).basename());
+            cmakelists_txt.append("\"\n");
+            cmakelists_txt.append("    VERBATIM\n");
+            cmakelists_txt.append(")\n");
+            cmakelists_txt.appendf("list(APPEND OUTPUT_STAMPS \"%s.meta-hash\")\n", output.characters());
+            cmakelists_txt.appendf("list(APPEND OUTPUT_FILES \"%s\")\n", output.characters());
         }
-        cmakelists_txt.append("    COMMENT \"Executing ");
-        cmakelists_txt.append(generator.key);
-        cmakelists_txt.append(" for target ");
-        cmakelists_txt.append(targetName);
-        cmakelists_txt.append("\"\n");
-        cmakelists_txt.append("    DEPENDS ${");
-        cmakelists_txt.append(generator.key);
-        cmakelists_txt.append("}\n");
+
+        cmakelists_txt.appendf("add_custom_target(%s_%s_outputs\n", targetName.characters(), generator.key.characters());
+        cmakelists_txt.append("    COMMAND ${CMAKE_COMMAND} \"-DCHECK_OUTPUTS=${OUTPUT_FILES}\" -P ${META_RUN_GENERATOR}\n");
+        cmakelists_txt.append("    VERBATIM\n");
         cmakelists_txt.append(")\n");
 
         cmakelists_txt.append("add_custom_target(");
         cmakelists_txt.append(targetName);
         cmakelists_txt.append("_");
         cmakelists_txt.append(generator.key);
-        cmakelists_txt.append(" DEPENDS ${OUTPUT_FILES})\n");
+        cmakelists_txt.append(" DEPENDS ${OUTPUT_STAMPS})\n");
+        cmakelists_txt.appendf("add_dependencies(%s_%s %s_%s_outputs)\n", targetName.characters(), generator.key.characters(),
+            targetName.characters(), generator.key.characters());
         cmakelists_txt.append("add_dependencies(");
         cmakelists_txt.append(targetName);
         cmakelists_txt.append(" ");
@@ -1034,18 +1443,18 @@ bool CMakeGenerator::gen_package(const Package& package)
     StringBuilder direct_linkage_include;
     // sources for source file linkage
     direct_linkage_include.append("list(APPEND SOURCES\n");
-    for (auto& source : package.sources()) {
+    for (auto source : package.sources()) {
         direct_linkage_include.append("    \"");
-        direct_linkage_include.append(make_path_with_cmake_variables(source));
+        direct_linkage_include.append(make_path_with_cmake_variables(PathStore::the().path(source)));
         direct_linkage_include.append("\"");
         direct_linkage_include.append("\n");
     }
     direct_linkage_include.append(")\n");
 
     direct_linkage_include.append("list(APPEND INCLUDE_DIRS\n");
-    for (auto& include : package.includes()) {
+    for (auto include : package.includes()) {
         direct_linkage_include.append("    \"");
-        direct_linkage_include.append(make_path_with_cmake_variables(include));
+        direct_linkage_include.append(make_path_with_cmake_variables(PathStore::the().path(include)));
         direct_linkage_include.append("\"");
         direct_linkage_include.append("\n");
     }
@@ -1121,7 +1530,45 @@ bool CMakeGenerator::gen_package(const Package& package)
     return true;
 }
 
-const String CMakeGenerator::gen_cmake_toolchain_content(const HashMap<String, Tool>& tools, Optional<const HashMap<String, HashMap<String, ToolConfiguration>>> toolchain_configuration)
+const String CMakeGenerator::gen_compiler_launcher(const String& language, const Tool& tool, const Optional<Launcher>& launcher) const
+{
+    /**
+     * Example for a compiler launcher with a local cache directory:
+     *
+     * find_program(META_CXX_COMPILER_LAUNCHER ccache)
+     * if(META_CXX_COMPILER_LAUNCHER)
+     *     set(CMAKE_CXX_COMPILER_LAUNCHER ${CMAKE_COMMAND} -E env "CCACHE_DIR=/build/ccache" ${META_CXX_COMPILER_LAUNCHER})
+     * endif()
+     */
+
+    // the launcher of a tool replaces the one of the toolchain, its environment included
+    const Launcher* selected = nullptr;
+    if (tool.launcher.has_value())
+        selected = &tool.launcher.value();
+    else if (launcher.has_value())
+        selected = &launcher.value();
+
+    if (!selected || selected->executable.is_empty())
+        return {};
+    auto& executable = selected->executable;
+
+    StringBuilder builder;
+    builder.appendf("find_program(META_%s_COMPILER_LAUNCHER %s)\n", language.characters(), executable.characters());
+    builder.appendf("if(META_%s_COMPILER_LAUNCHER)\n", language.characters());
+    builder.appendf("    set(CMAKE_%s_COMPILER_LAUNCHER", language.characters());
+    if (selected->environment.size()) {
+        builder.append(" ${CMAKE_COMMAND} -E env");
+        for (auto* variable : sorted_entries(selected->environment))
+            builder.appendf(" \"%s=%s\"", variable->key.characters(), variable->value.characters());
+    }
+    builder.appendf(" ${META_%s_COMPILER_LAUNCHER})\n", language.characters());
+    builder.append("else()\n");
+    builder.appendf("    message(STATUS \"Compiler launcher %s not found, compiling without it.\")\n", executable.characters());
+    builder.append("endif()\n\n");
+    return builder.build();
+}
+
+const String CMakeGenerator::gen_cmake_toolchain_content(const HashMap<String, Tool>& tools, Optional<const HashMap<String, HashMap<String, ToolConfiguration>>> toolchain_configuration, const Optional<Launcher>& launcher, u32 memory_weight)
 {
     StringBuilder target_toolchain_cmake;
     target_toolchain_cmake.append(gen_header());
@@ -1129,7 +1576,8 @@ const String CMakeGenerator::gen_cmake_toolchain_content(const HashMap<String, T
     target_toolchain_cmake.append("if(LOADED)\n     return()\nendif()\nset(LOADED true)\n\n");
     target_toolchain_cmake.append("if(NOT CMAKE_BUILD_TYPE)\n     set(CMAKE_BUILD_TYPE Debug)\nendif()\n\n");
 
-    for (auto tool : tools) {
+    for (auto* tool_entry : sorted_entries(tools)) {
+        auto& tool = *tool_entry;
         if (tool.key == "cxx") {
             target_toolchain_cmake.append("set(CMAKE_CXX_COMPILER ");
             target_toolchain_cmake.append(tool.value.executable);
@@ -1143,6 +1591,7 @@ const String CMakeGenerator::gen_cmake_toolchain_content(const HashMap<String, T
             target_toolchain_cmake.append(tool.value.test_flags);
             target_toolchain_cmake.append("\" CACHE STRING \"\" FORCE)");
             target_toolchain_cmake.append("\n\n");
+            target_toolchain_cmake.append(gen_compiler_launcher("CXX", tool.value, launcher));
 
         } else if (tool.key == "cc") {
             target_toolchain_cmake.append("set(CMAKE_C_COMPILER ");
@@ -1157,6 +1606,7 @@ const String CMakeGenerator::gen_cmake_toolchain_content(const HashMap<String, T
             target_toolchain_cmake.append(tool.value.test_flags);
             target_toolchain_cmake.append("\" CACHE STRING \"\" FORCE)");
             target_toolchain_cmake.append("\n\n");
+            target_toolchain_cmake.append(gen_compiler_launcher("C", tool.value, launcher));
 
         } else if (tool.key == "link") {
             target_toolchain_cmake.append("set(CMAKE_EXE_LINKER_FLAGS \"");
@@ -1177,13 +1627,38 @@ const String CMakeGenerator::gen_cmake_toolchain_content(const HashMap<String, T
     target_toolchain_cmake.append("set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)");
     target_toolchain_cmake.append("\n");
 
+    // compile and link concurrency sized by meta for the cores and memory of the host (Ninja only)
+    target_toolchain_cmake.append("if(META_COMPILE_JOBS AND META_LINK_JOBS)\n");
+    if (memory_weight > 1) {
+        // Ninja has no weighted jobs, so the memory heavy packages get pools of 1/weight of
+        // the jobs, and the pools of all other packages shrink by the same amount
+        target_toolchain_cmake.appendf("    math(EXPR META_HEAVY_COMPILE_JOBS \"(${META_COMPILE_JOBS} + %u) / %u\")\n", memory_weight - 1, memory_weight);
+        target_toolchain_cmake.appendf("    math(EXPR META_HEAVY_LINK_JOBS \"(${META_LINK_JOBS} + %u) / %u\")\n", memory_weight - 1, memory_weight);
+        target_toolchain_cmake.append("    math(EXPR META_SHARED_COMPILE_JOBS \"${META_COMPILE_JOBS} - ${META_HEAVY_COMPILE_JOBS}\")\n");
+        target_toolchain_cmake.append("    math(EXPR META_SHARED_LINK_JOBS \"${META_LINK_JOBS} - ${META_HEAVY_LINK_JOBS}\")\n");
+        target_toolchain_cmake.append("    if(META_SHARED_COMPILE_JOBS GREATER 0 AND META_SHARED_LINK_JOBS GREATER 0)\n");
+        target_toolchain_cmake.append("        set(META_HEAVY_JOB_POOLS true)\n");
+        target_toolchain_cmake.append("        set_property(GLOBAL PROPERTY JOB_POOLS meta_compile=${META_SHARED_COMPILE_JOBS} meta_link=${META_SHARED_LINK_JOBS}\n");
+        target_toolchain_cmake.append("            meta_compile_heavy=${META_HEAVY_COMPILE_JOBS} meta_link_heavy=${META_HEAVY_LINK_JOBS})\n");
+        target_toolchain_cmake.append("    else()\n");
+        target_toolchain_cmake.append("        set_property(GLOBAL PROPERTY JOB_POOLS meta_compile=${META_COMPILE_JOBS} meta_link=${META_LINK_JOBS})\n");
+        target_toolchain_cmake.append("    endif()\n");
+    } else {
+        target_toolchain_cmake.append("    set_property(GLOBAL PROPERTY JOB_POOLS meta_compile=${META_COMPILE_JOBS} meta_link=${META_LINK_JOBS})\n");
+    }
+    target_toolchain_cmake.append("    set(CMAKE_JOB_POOL_COMPILE meta_compile)\n");
+    target_toolchain_cmake.append("    set(CMAKE_JOB_POOL_LINK meta_link)\n");
+    target_toolchain_cmake.append("endif()\n");
+
     if (toolchain_configuration.has_value()) {
-        for (auto& configuration : toolchain_configuration.value()) {
+        for (auto* configuration_entry : sorted_entries(toolchain_configuration.value())) {
+            auto& configuration = *configuration_entry;
             target_toolchain_cmake.append("if(CMAKE_BUILD_TYPE STREQUAL \"");
             target_toolchain_cmake.append(configuration.key);
             target_toolchain_cmake.append("\")");
             target_toolchain_cmake.append("\n");
-            for (auto& tool : configuration.value) {
+            for (auto* tool_entry : sorted_entries(configuration.value)) {
+                auto& tool = *tool_entry;
 
                 if (tool.key == "cxx") {
                     target_toolchain_cmake.append("    set(CMAKE_CXX_FLAGS \"${CMAKE_CXX_FLAGS} ");
@@ -1255,9 +1730,9 @@ String CMakeGenerator::gen_toolchain_package(const Package& package)
 
         if (package.dependencies().size()) {
             for (auto& dependency : package.dependencies()) {
-                if (dependency.value == LinkageType::Direct || dependency.value == LinkageType::HeaderOnly)
+                if (dependency.linkage == LinkageType::Direct || dependency.linkage == LinkageType::HeaderOnly)
                     continue;
-                depends_builder.append(dependency.key);
+                depends_builder.append(dependency.name);
                 depends_builder.append(" ");
             }
         }
@@ -1321,7 +1796,8 @@ StringBuilder CMakeGenerator::gen_toolchain_cmakelists_txt()
 
     cmakelists_txt.append("set(CMAKE_INSTALL_PREFIX \"/usr\" CACHE INTERNAL \"\" FORCE)\n\n");
 
-    cmakelists_txt.append("include(tools.cmake)\n\n");
+    cmakelists_txt.append("include(tools.cmake)\n");
+    cmakelists_txt.append("set(META_RUN_GENERATOR ${CMAKE_CURRENT_LIST_DIR}/../run_generator.cmake)\n\n");
     cmakelists_txt.append(make_command_workaround());
     cmakelists_txt.append(includes());
 
@@ -1331,7 +1807,8 @@ StringBuilder CMakeGenerator::gen_toolchain_cmakelists_txt()
 const String CMakeGenerator::find_tools_not_in_toolchain(const HashMap<String, Tool>& tools) const
 {
     StringBuilder find_tools_not_in_toolchain;
-    for (auto tool : tools) {
+    for (auto* tool_entry : sorted_entries(tools)) {
+        auto& tool = *tool_entry;
         if (!HostPackageDB::the().find_package_that_provides(tool.key)) {
             find_tools_not_in_toolchain.append("find_program(");
             find_tools_not_in_toolchain.append(tool.key.to_uppercase());
@@ -1355,7 +1832,55 @@ const String CMakeGenerator::find_tools_not_in_toolchain(const HashMap<String, T
     return find_tools_not_in_toolchain.build();
 }
 
-bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<String>& json_input_files)
+const String CMakeGenerator::gen_run_generator_script() const
+{
+    /**
+     * Script for running a generator of run_generators, invoked with
+     * cmake -DGENERATOR=... -DFLAGS=... -DINPUT=... -DOUTPUT=... -P run_generator.cmake
+     *
+     * The generator is only executed if the hash of the input, the generator binary and the flags
+     * differs from the stored one in ${OUTPUT}.meta-hash. The output file is only replaced if its
+     * content changed, so targets depending on it are not rebuilt for an identical regeneration.
+     *
+     * With -DCHECK_OUTPUTS=<output>;<output>... it removes the stamps of outputs that do not
+     * exist, so their commands run again.
+     */
+    StringBuilder script;
+    script.append(gen_header());
+    script.append("if(DEFINED CHECK_OUTPUTS)\n");
+    script.append("    foreach(CHECKED_OUTPUT IN LISTS CHECK_OUTPUTS)\n");
+    script.append("        if(NOT EXISTS \"${CHECKED_OUTPUT}\")\n");
+    script.append("            file(REMOVE \"${CHECKED_OUTPUT}.meta-hash\")\n");
+    script.append("        endif()\n");
+    script.append("    endforeach()\n");
+    script.append("    return()\n");
+    script.append("endif()\n\n");
+    script.append("file(SHA256 \"${INPUT}\" INPUT_HASH)\n");
+    script.append("file(SHA256 \"${GENERATOR}\" GENERATOR_HASH)\n");
+    script.append("string(SHA256 HASH \"${INPUT_HASH}${GENERATOR_HASH}${FLAGS}\")\n");
+    script.append("if(EXISTS \"${OUTPUT}\" AND EXISTS \"${OUTPUT}.meta-hash\")\n");
+    script.append("    file(READ \"${OUTPUT}.meta-hash\" PREVIOUS_HASH)\n");
+    script.append("    if(PREVIOUS_HASH STREQUAL HASH)\n");
+    script.append("        # refresh the stamp, so it is newer than its dependencies\n");
+    script.append("        file(WRITE \"${OUTPUT}.meta-hash\" \"${HASH}\")\n");
+    script.append("        return()\n");
+    script.append("    endif()\n");
+    script.append("endif()\n\n");
+    script.append("separate_arguments(GENERATOR_FLAGS UNIX_COMMAND \"${FLAGS}\")\n");
+    script.append("execute_process(COMMAND \"${GENERATOR}\" ${GENERATOR_FLAGS} \"${INPUT}\"\n");
+    script.append("    OUTPUT_FILE \"${OUTPUT}.tmp\"\n");
+    script.append("    RESULT_VARIABLE GENERATOR_RESULT)\n");
+    script.append("if(NOT GENERATOR_RESULT EQUAL 0)\n");
+    script.append("    file(REMOVE \"${OUTPUT}.tmp\")\n");
+    script.append("    message(FATAL_ERROR \"${GENERATOR} failed for ${INPUT}: ${GENERATOR_RESULT}\")\n");
+    script.append("endif()\n");
+    script.append("execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different \"${OUTPUT}.tmp\" \"${OUTPUT}\")\n");
+    script.append("file(REMOVE \"${OUTPUT}.tmp\")\n");
+    script.append("file(WRITE \"${OUTPUT}.meta-hash\" \"${HASH}\")\n");
+    return script.build();
+}
+
+bool CMakeGenerator::write_toolchain(const Toolchain& toolchain, const Vector<String>& json_input_files)
 {
     /**
      * This generates the toolchain file: Build/toolchain.cmake
@@ -1364,6 +1889,7 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
      * This generates the toolchain file: Build/CMakeLists.txt
      * This generates the toolchain file: Target/CMakeLists.txt
      * This generates the tool reconfiguration input file: meta_json_files.depend
+     * This generates the generator wrapper script: run_generator.cmake
      */
 
     /**
@@ -1383,7 +1909,7 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
      * set(CMAKE_SYSROOT "Build/Toolchain/Sysroot")
      */
 
-    auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
     if (gen_path.is_empty()) {
         return false;
     }
@@ -1401,9 +1927,10 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
         return false;
     //fprintf(stdout, "Gendata directory: %s\n", gen_path.value().characters());
 
-    String target_toolchain_cmake = gen_cmake_toolchain_content(toolchain.target_tools(), toolchain.configuration());
-    String build_toolchain_cmake = gen_cmake_toolchain_content(toolchain.build_tools(), {});
-    String host_toolchain_cmake = gen_cmake_toolchain_content(toolchain.host_tools(), {});
+    // the heavy job pools of a toolchain are sized for the heaviest of its packages
+    String target_toolchain_cmake = gen_cmake_toolchain_content(toolchain.target_tools(), toolchain.configuration(), toolchain.launcher(), TargetPackageDB::the().max_memory_weight());
+    String build_toolchain_cmake = gen_cmake_toolchain_content(toolchain.build_tools(), {}, toolchain.launcher(), BuildPackageDB::the().max_memory_weight());
+    String host_toolchain_cmake = gen_cmake_toolchain_content(toolchain.host_tools(), {}, toolchain.launcher(), HostPackageDB::the().max_memory_weight());
 
     FILE* fd;
 
@@ -1474,7 +2001,7 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
         return false;
     }
 
-    auto root = SettingsProvider::the().get_string("root").value_or("");
+    auto root = SettingsProvider::the().root().value_or("");
 
     // Build/tools.cmake
     String build_tools_cmake = find_tools_not_in_toolchain(toolchain.build_tools());
@@ -1504,18 +2031,18 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
     // Build/CMakeLists.txt
     auto build_cmakelists_txt = gen_toolchain_cmakelists_txt();
 
-    Vector<Package> build_packages_to_build;
+    Vector<const Package*> build_packages_to_build;
 
     BuildPackageDB::the().for_each_entry([&](auto&, auto& package) {
         if (package.type() != PackageType::Script) {
-            build_packages_to_build.append(package);
+            build_packages_to_build.append(&package);
         }
         return IterationDecision::Continue;
     });
 
     Vector<String> build_processed_packages;
-    for (auto& package : build_packages_to_build) {
-        auto node = DependencyResolver::the().get_dependency_tree(package);
+    for (auto* package : build_packages_to_build) {
+        auto node = DependencyResolver::the().get_dependency_tree(*package);
         if (node) {
             // go to leaves
             DependencyNode::start_by_leave(node, [&](auto& package) {
@@ -1584,18 +2111,19 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
     host_cmakelists_txt.append("    enable_testing()\n");
     host_cmakelists_txt.append("endif()\n\n");
 
-    Vector<Package> host_packages_to_build;
+    Vector<const Package*> host_packages_to_build;
 
     HostPackageDB::the().for_each_entry([&](auto&, auto& package) {
         if (package.type() != PackageType::Script) {
-            host_packages_to_build.append(package);
+            host_packages_to_build.append(&package);
         }
         return IterationDecision::Continue;
     });
 
     Vector<String> host_processed_packages;
-    for (auto& package : host_packages_to_build) {
-        auto node = DependencyResolver::the().get_dependency_tree(package);
+    Vector<String> host_targets;
+    for (auto* package : host_packages_to_build) {
+        auto node = DependencyResolver::the().get_dependency_tree(*package);
         if (node) {
             // go to leaves
             DependencyNode::start_by_leave(node, [&](auto& package) {
@@ -1610,6 +2138,9 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
                             package.name().characters(),
                             package.name().characters());
 
+                        if (package.type() == PackageType::Library || package.type() == PackageType::Executable || package.type() == PackageType::Collection)
+                            host_targets.append(package.name());
+
                         host_processed_packages.append(package.name());
                     }
                 }
@@ -1617,6 +2148,24 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
         }
     }
 
+    if (single_configure()) {
+        // The host packages are part of the root project, the install into the host sysroot
+        // is done by running the install script of this directory instead of an ExternalProject.
+        host_cmakelists_txt.append("\n");
+        for (auto& target : host_targets)
+            host_cmakelists_txt.appendf("add_dependencies(%s BuildToolchain)\n", target.characters());
+        host_cmakelists_txt.append("\n");
+        host_cmakelists_txt.append("add_custom_target(HostToolchain ALL\n");
+        host_cmakelists_txt.append("    COMMAND ${CMAKE_COMMAND} -E env DESTDIR=${CMAKE_BINARY_DIR}/Sysroots/Host ${CMAKE_COMMAND} -P ${CMAKE_CURRENT_BINARY_DIR}/cmake_install.cmake\n");
+        host_cmakelists_txt.append("    COMMENT \"Installing host toolchain into ${CMAKE_BINARY_DIR}/Sysroots/Host\"\n");
+        host_cmakelists_txt.append(")\n");
+        if (host_targets.size()) {
+            host_cmakelists_txt.append("add_dependencies(HostToolchain ");
+            host_cmakelists_txt.join(" ", host_targets);
+            host_cmakelists_txt.append(")\n");
+        }
+    }
+
     // write out
     StringBuilder host_cmakelists_txt_filename;
     host_cmakelists_txt_filename.append(gen_path);
@@ -1670,13 +2219,38 @@ bool CMakeGenerator::gen_toolchain(const Toolchain& toolchain, const Vector<Stri
         return false;
     }
 
+    // run_generator.cmake
+    String run_generator_cmake = gen_run_generator_script();
+
+    // write out
+    StringBuilder run_generator_cmake_filename;
+    run_generator_cmake_filename.append(gen_path);
+    run_generator_cmake_filename.append("/Toolchain/run_generator.cmake");
+    fd = fopen(run_generator_cmake_filename.build().characters(), "w+");
+
+    if (!fd) {
+        perror("fopen");
+        return false;
+    }
+
+    bytes = fwrite(run_generator_cmake.characters(), 1, run_generator_cmake.length(), fd);
+    if (bytes != run_generator_cmake.length()) {
+        perror("fwrite");
+        return false;
+    }
+
+    if (fclose(fd) < 0) {
+        perror("fclose");
+        return false;
+    }
+
     return true;
 }
 
-bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
+bool CMakeGenerator::write_root(const Toolchain& toolchain, int argc, char** argv)
 {
 
-    auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
 
     if (gen_path.is_empty()) {
         return false;
@@ -1687,6 +2261,12 @@ bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
     cmakelists_txt.append(gen_header());
     cmakelists_txt.append(cmake_minimum_version());
 
+    bool is_single_configure = single_configure();
+    if (is_single_configure) {
+        // Single configure super-build: the host packages are configured together with the root project
+        cmakelists_txt.append("set(CMAKE_TOOLCHAIN_FILE ${CMAKE_CURRENT_LIST_DIR}/Toolchain/Host/toolchain.cmake)\n");
+    }
+
     cmakelists_txt.append("project(root)\n");
 
     cmakelists_txt.append(project_root_dir());
@@ -1713,7 +2293,8 @@ bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
     cmakelists_txt.append("endif()\n");
     cmakelists_txt.append("add_custom_command(\n");
     cmakelists_txt.append("    OUTPUT ${CMAKE_CURRENT_LIST_DIR}/Toolchain/meta_json_files.depend\n");
-    cmakelists_txt.append("    COMMAND ${META_BINARY} ${META_ARGUMENTS}\n");
+    // an edited meta json file only affects the parts that are generated from it
+    cmakelists_txt.append("    COMMAND ${META_BINARY} ${META_ARGUMENTS} --only-stale\n");
     cmakelists_txt.append("    DEPENDS ${META_JSON_FILES_DEPEND} ${META_BINARY}\n");
     cmakelists_txt.append("    WORKING_DIRECTORY ${WORKING_DIRECTORY}\n");
     cmakelists_txt.append("    COMMENT \"Run meta...\"\n");
@@ -1741,6 +2322,8 @@ bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
     cmakelists_txt.append("        -DCMAKE_TOOLCHAIN_FILE=${CMAKE_CURRENT_LIST_DIR}/Toolchain/Build/toolchain.cmake\n");
     cmakelists_txt.append("        -DCMAKE_SYSROOT=${CMAKE_BINARY_DIR}/Sysroots/Host\n");
     cmakelists_txt.append("        -DDOWNLOAD_DIRECTORY=${DOWNLOAD_DIRECTORY}\n");
+    cmakelists_txt.append("        -DMETA_COMPILE_JOBS=${META_COMPILE_JOBS}\n");
+    cmakelists_txt.append("        -DMETA_LINK_JOBS=${META_LINK_JOBS}\n");
     cmakelists_txt.append("    BINARY_DIR ${CMAKE_BINARY_DIR}/BuildToolchain\n");
     cmakelists_txt.append("    INSTALL_COMMAND \"\"\n");
     cmakelists_txt.append(")\n");
@@ -1748,26 +2331,44 @@ bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
     cmakelists_txt.append("#set_directory_properties(PROPERTIES ADDITIONAL_MAKE_CLEAN_FILES BuildToolchain)\n");
     cmakelists_txt.append("\n");
 
-    // host toolchain
-    cmakelists_txt.append("ExternalProject_Add(HostToolchain\n");
-    cmakelists_txt.append("    DEPENDS BuildToolchain auto-meta-generation\n");
-    cmakelists_txt.append("    PREFIX ${CMAKE_BINARY_DIR}/HostToolchain\n");
-    cmakelists_txt.append("    SOURCE_DIR ${CMAKE_SOURCE_DIR}/Toolchain/Host\n");
-    cmakelists_txt.append("    CMAKE_ARGS\n");
-    cmakelists_txt.append("        -DCMAKE_TOOLCHAIN_FILE=${CMAKE_CURRENT_LIST_DIR}/Toolchain/Host/toolchain.cmake\n");
-    cmakelists_txt.append("        -DDOWNLOAD_DIRECTORY=${DOWNLOAD_DIRECTORY}\n");
-    cmakelists_txt.append("    BINARY_DIR ${CMAKE_BINARY_DIR}/HostToolchain\n");
-    cmakelists_txt.append("    INSTALL_COMMAND DESTDIR=${CMAKE_BINARY_DIR}/Sysroots/Host cmake --build . --target install\n");
-    cmakelists_txt.append("    BUILD_ALWAYS true\n");
-    cmakelists_txt.append("    TEST_COMMAND ${CMAKE_CTEST_COMMAND} --verbose\n");
-    //FIXME: Make it configureable, when tests should be run
-    //cmakelists_txt.append("    TEST_BEFORE_INSTALL true\n");
-    cmakelists_txt.append("    TEST_EXCLUDE_FROM_MAIN true\n");
-    cmakelists_txt.append(")\n");
-    cmakelists_txt.append("set_directory_properties(PROPERTIES ADDITIONAL_MAKE_CLEAN_FILES ${CMAKE_BINARY_DIR}/HostToolchain)\n");
-    cmakelists_txt.append("ExternalProject_Add_StepTargets(HostToolchain test)\n");
-    cmakelists_txt.append("add_custom_target(run-tests DEPENDS HostToolchain-test)\n");
-    cmakelists_txt.append("\n");
+    // host toolchain, run-tests runs as many tests at once as compile jobs
+    cmakelists_txt.append("if(META_COMPILE_JOBS)\n");
+    cmakelists_txt.append("    set(META_TEST_JOBS ${META_COMPILE_JOBS})\n");
+    cmakelists_txt.append("else()\n");
+    cmakelists_txt.append("    cmake_host_system_information(RESULT META_TEST_JOBS QUERY NUMBER_OF_LOGICAL_CORES)\n");
+    cmakelists_txt.append("endif()\n");
+    if (is_single_configure) {
+        // no separate configure step, the HostToolchain target is defined in Toolchain/Host/CMakeLists.txt
+        cmakelists_txt.append("add_subdirectory(Toolchain/Host HostToolchain)\n");
+        cmakelists_txt.append("add_custom_target(run-tests\n");
+        cmakelists_txt.append("    COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure -j ${META_TEST_JOBS}\n");
+        cmakelists_txt.append("    WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/HostToolchain\n");
+        cmakelists_txt.append("    DEPENDS HostToolchain\n");
+        cmakelists_txt.append(")\n");
+        cmakelists_txt.append("\n");
+    } else {
+        cmakelists_txt.append("ExternalProject_Add(HostToolchain\n");
+        cmakelists_txt.append("    DEPENDS BuildToolchain auto-meta-generation\n");
+        cmakelists_txt.append("    PREFIX ${CMAKE_BINARY_DIR}/HostToolchain\n");
+        cmakelists_txt.append("    SOURCE_DIR ${CMAKE_SOURCE_DIR}/Toolchain/Host\n");
+        cmakelists_txt.append("    CMAKE_ARGS\n");
+        cmakelists_txt.append("        -DCMAKE_TOOLCHAIN_FILE=${CMAKE_CURRENT_LIST_DIR}/Toolchain/Host/toolchain.cmake\n");
+        cmakelists_txt.append("        -DDOWNLOAD_DIRECTORY=${DOWNLOAD_DIRECTORY}\n");
+        cmakelists_txt.append("        -DMETA_COMPILE_JOBS=${META_COMPILE_JOBS}\n");
+        cmakelists_txt.append("        -DMETA_LINK_JOBS=${META_LINK_JOBS}\n");
+        cmakelists_txt.append("    BINARY_DIR ${CMAKE_BINARY_DIR}/HostToolchain\n");
+        cmakelists_txt.append("    INSTALL_COMMAND DESTDIR=${CMAKE_BINARY_DIR}/Sysroots/Host cmake --build . --target install\n");
+        cmakelists_txt.append("    BUILD_ALWAYS true\n");
+        cmakelists_txt.append("    TEST_COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure -j ${META_TEST_JOBS}\n");
+        //FIXME: Make it configureable, when tests should be run
+        //cmakelists_txt.append("    TEST_BEFORE_INSTALL true\n");
+        cmakelists_txt.append("    TEST_EXCLUDE_FROM_MAIN true\n");
+        cmakelists_txt.append(")\n");
+        cmakelists_txt.append("set_directory_properties(PROPERTIES ADDITIONAL_MAKE_CLEAN_FILES ${CMAKE_BINARY_DIR}/HostToolchain)\n");
+        cmakelists_txt.append("ExternalProject_Add_StepTargets(HostToolchain test)\n");
+        cmakelists_txt.append("add_custom_target(run-tests DEPENDS HostToolchain-test)\n");
+        cmakelists_txt.append("\n");
+    }
 
     // target build
     cmakelists_txt.append("ExternalProject_Add(Target\n");
@@ -1779,6 +2380,8 @@ bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
     cmakelists_txt.append("        -DCMAKE_SYSROOT=${CMAKE_BINARY_DIR}/Sysroots/Host\n");
     cmakelists_txt.append("        -DCMAKE_TARGET_SYSROOT=${CMAKE_BINARY_DIR}/Sysroots/Target\n");
     cmakelists_txt.append("        -DDOWNLOAD_DIRECTORY=${DOWNLOAD_DIRECTORY}\n");
+    cmakelists_txt.append("        -DMETA_COMPILE_JOBS=${META_COMPILE_JOBS}\n");
+    cmakelists_txt.append("        -DMETA_LINK_JOBS=${META_LINK_JOBS}\n");
     cmakelists_txt.append("    BINARY_DIR ${CMAKE_BINARY_DIR}/Target\n");
     cmakelists_txt.append("    INSTALL_COMMAND DESTDIR=${CMAKE_BINARY_DIR}/Sysroots/Target cmake --build . --target install\n");
     cmakelists_txt.append("    BUILD_ALWAYS true\n");
@@ -1786,7 +2389,8 @@ bool CMakeGenerator::gen_root(const Toolchain& toolchain, int argc, char** argv)
     cmakelists_txt.append("set_directory_properties(PROPERTIES ADDITIONAL_MAKE_CLEAN_FILES ${CMAKE_BINARY_DIR}/Target)\n");
     cmakelists_txt.append("\n\n");
 
-    for (auto& tool : toolchain.host_tools()) {
+    for (auto* tool_entry : sorted_entries(toolchain.host_tools())) {
+        auto& tool = *tool_entry;
         if (tool.value.add_as_target) {
             cmakelists_txt.append("add_custom_target(");
             cmakelists_txt.append(tool.key);
@@ -3,8 +3,11 @@
 #include "Image.h"
 #include "Package.h"
 #include "Toolchain.h"
+#include <AK/HashTable.h>
 #include <LibCore/Object.h>
 
+class GenerationStamp;
+
 class CMakeGenerator : public Core::Object {
     C_OBJECT(CMakeGenerator)
 
@@ -17,15 +20,38 @@ public:
     bool gen_toolchain(const Toolchain&, const Vector<String>& json_input_files);
     bool gen_root(const Toolchain&, int argc, char** argv);
 
+    // don't write the parts whose generation stamp matches their current inputs
+    void set_only_stale(bool only_stale) { m_only_stale = only_stale; }
+    u32 generated_count() const { return m_generated_count; }
+    u32 up_to_date_count() const { return m_up_to_date_count; }
+
 private:
     CMakeGenerator();
 
-    const String gen_cmake_toolchain_content(const HashMap<String, Tool>&, Optional<const HashMap<String, HashMap<String, ToolConfiguration>>>);
+    bool write_image(const Image&, const Vector<const Package*>);
+    bool write_package(const Package&);
+    bool write_toolchain(const Toolchain&, const Vector<String>& json_input_files);
+    bool write_root(const Toolchain&, int argc, char** argv);
+
+    bool is_up_to_date(const GenerationStamp&);
+    bool write_stamp(const GenerationStamp&);
+    u64 file_input_hash(const String& filename);
+    u64 global_input_hash();
+    u64 package_input_hash(const Package&);
+
+    const String gen_cmake_toolchain_content(const HashMap<String, Tool>&, Optional<const HashMap<String, HashMap<String, ToolConfiguration>>>, const Optional<Launcher>&, u32 memory_weight);
+    const String gen_compiler_launcher(const String& language, const Tool&, const Optional<Launcher>&) const;
     String gen_toolchain_package(const Package&);
     StringBuilder gen_toolchain_cmakelists_txt();
     String gen_package_collection(const Package&);
 
+    void build_path_templates();
     String make_path_with_cmake_variables(const String& path);
+    JsonValue generator_option(const String& key) const;
+    bool single_configure() const;
+    u32 unity_build_batch_size(const Package&) const;
+    bool is_unity_build_source(const Package&, PathId source_id, const String& source) const;
+    Vector<String> most_included_headers(const Package&, u32 count) const;
     bool gen_test_executable(const Package& package, const TestExecutable& test_executable);
 
     const String gen_header() const;
@@ -35,4 +61,21 @@ private:
     const String make_command_workaround() const;
     const String includes() const;
     const String find_tools_not_in_toolchain(const HashMap<String, Tool>& tools) const;
+    const String gen_run_generator_script() const;
+
+    struct PathPrefix {
+        String prefix;
+        String replacement;
+    };
+    Vector<PathPrefix> m_path_prefixes;
+    HashMap<String, String> m_cmake_variables;
+    bool m_path_templates_built { false };
+
+    bool m_only_stale { false };
+    u32 m_generated_count { 0 };
+    u32 m_up_to_date_count { 0 };
+    Optional<u64> m_global_input_hash;
+    HashMap<String, u64> m_file_hashes;
+    HashMap<u32, u64> m_package_input_hashes;
+    HashTable<String> m_handled_stamps;
 };
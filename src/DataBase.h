@@ -1,10 +1,66 @@
 #pragma once
 
 #include <AK/HashMap.h>
+#include <AK/HashTable.h>
 #include <AK/JsonObject.h>
+#include <AK/NonnullOwnPtr.h>
 #include <AK/Optional.h>
+#include <AK/QuickSort.h>
 #include <LibCore/Object.h>
+#include <string.h>
 
+inline int compare_names(const StringView& a, const StringView& b)
+{
+    size_t length = min(a.length(), b.length());
+    if (length) {
+        int result = memcmp(a.characters_without_null_termination(), b.characters_without_null_termination(), length);
+        if (result)
+            return result;
+    }
+    if (a.length() == b.length())
+        return 0;
+    return a.length() < b.length() ? -1 : 1;
+}
+
+template<typename K>
+inline bool key_less(const K& a, const K& b)
+{
+    return a < b;
+}
+
+inline bool key_less(const String& a, const String& b)
+{
+    return compare_names(a, b) < 0;
+}
+
+// HashMap entries in key order, so generated output does not depend on the hash order
+template<typename Map>
+auto sorted_entries(const Map& map)
+{
+    Vector<decltype(&*map.begin())> entries;
+    entries.ensure_capacity(map.size());
+    for (auto& entry : map)
+        entries.append(&entry);
+    quick_sort(entries.begin(), entries.end(), [](auto* a, auto* b) {
+        return key_less(a->key, b->key);
+    });
+    return entries;
+}
+
+inline Vector<String> sorted_strings(const HashTable<String>& table)
+{
+    Vector<String> strings;
+    strings.ensure_capacity(table.size());
+    for (auto& string : table)
+        strings.append(string);
+    quick_sort(strings.begin(), strings.end(), [](auto& a, auto& b) {
+        return compare_names(a, b) < 0;
+    });
+    return strings;
+}
+
+// A DataBase is filled while loading the meta json files. After freeze(), it is a read-only,
+// sorted array of entries, which can be shared without synchronization.
 template<class T>
 class DataBase : public Core::Object {
     C_OBJECT(DataBase)
@@ -12,37 +68,118 @@ class DataBase : public Core::Object {
 public:
     virtual ~DataBase() {};
 
+    // entries are heap allocated once and never moved, pointers to them stay valid
     template<class... Args>
-    bool add(String name, Args&&... args)
+    bool add(const String& name, Args&&... args)
     {
+        ASSERT(!m_frozen);
         if (m_entries.find(name) != m_entries.end())
             return false;
-        m_entries.set(name, { name, forward<Args>(args)... });
+        m_entries.set(name, make<T>(name, forward<Args>(args)...));
         return true;
     }
 
+    void freeze()
+    {
+        if (m_frozen)
+            return;
+
+        m_frozen_entries.ensure_capacity(m_entries.size());
+        for (auto& entry : m_entries)
+            m_frozen_entries.append({ entry.key, entry.value.ptr() });
+        quick_sort(m_frozen_entries.begin(), m_frozen_entries.end(), [](auto& a, auto& b) {
+            return compare_names(a.name, b.name) < 0;
+        });
+        m_frozen = true;
+    }
+
+    bool is_frozen() const { return m_frozen; }
+
+    // "meta serve" replaces the entries of a changed meta json file in place, freeze() sorts again
+    void thaw()
+    {
+        m_frozen_entries.clear();
+        m_frozen = false;
+    }
+
+    void remove(const String& name)
+    {
+        ASSERT(!m_frozen);
+        m_entries.remove(name);
+    }
+
     const T* get(StringView name) const
     {
+        if (m_frozen) {
+            size_t begin = 0;
+            size_t end = m_frozen_entries.size();
+            while (begin < end) {
+                size_t middle = begin + (end - begin) / 2;
+                int result = compare_names(name, m_frozen_entries[middle].name);
+                if (!result)
+                    return m_frozen_entries[middle].value;
+                if (result < 0)
+                    end = middle;
+                else
+                    begin = middle + 1;
+            }
+            return nullptr;
+        }
+
         auto it = m_entries.find(name);
         if (it == m_entries.end())
             return nullptr;
 
-        return &(*it).value;
+        return (*it).value.ptr();
     }
 
     template<typename Callback>
-    void for_each_entry(Callback callback)
+    void for_each_entry(Callback callback) const
     {
+        if (m_frozen) {
+            for (auto& entry : m_frozen_entries) {
+                if (callback(entry.name, *entry.value) == IterationDecision::Break)
+                    break;
+            }
+            return;
+        }
+
         for (auto& entry : m_entries) {
-            if (callback(entry.key, entry.value) == IterationDecision::Break)
+            if (callback(entry.key, static_cast<const T&>(*entry.value)) == IterationDecision::Break)
                 break;
         }
     };
 
-    const HashMap<String, T>& entries() { return m_entries; }
+    // only allowed while loading, i.e. before freeze()
+    template<typename Callback>
+    void for_each_mutable_entry(Callback callback)
+    {
+        ASSERT(!m_frozen);
+        for (auto& entry : m_entries) {
+            if (callback(entry.key, *entry.value) == IterationDecision::Break)
+                break;
+        }
+    };
+
+    // only allowed while loading, drops a partially loaded model
+    void clear()
+    {
+        ASSERT(!m_frozen);
+        m_entries.clear();
+    }
+
+    size_t size() const { return m_entries.size(); }
+    const HashMap<String, NonnullOwnPtr<T>>& entries() { return m_entries; }
 
 protected:
     DataBase() {};
 
-    HashMap<String, T> m_entries;
+    struct FrozenEntry {
+        String name;
+        const T* value;
+    };
+
+    HashMap<String, NonnullOwnPtr<T>> m_entries;
+    Vector<FrozenEntry> m_frozen_entries;
+    bool m_frozen { false };
 };
@@ -1,6 +1,7 @@
 #include "DependencyResolver.h"
 #include "FileProvider.h"
 #include "PackageDB.h"
+#include "Profiler.h"
 
 DependencyNode::DependencyNode()
 {
@@ -34,71 +35,80 @@ NonnullOwnPtr<DependencyNode> DependencyResolver::get_dependency_tree(const Pack
     auto m = make<DependencyNode>();
     m->package = &package;
 
-    auto dependencies = package.dependencies();
-
-    for (auto& dependency : dependencies) {
-        bool found_package = false;
-
-        const Package* dependent_package = package_db_for_machine(package.machine()).get(dependency.key);
-
+    for (auto& dependency : package.dependencies()) {
 #ifdef DEBUG_META
-        fprintf(stderr, "Package %s has dependency: %s\n", package.name().characters(), dependency.key.characters());
+        fprintf(stderr, "Package %s has dependency: %s\n", package.name().characters(), dependency.name.characters());
 #endif
+        const Package* dependent_package = package_db_for_machine(package.machine()).find_dependency(package, dependency.name);
         if (dependent_package) {
-            found_package = true;
             m->children.append(get_dependency_tree(*dependent_package));
 #ifdef DEBUG_META
             fprintf(stderr, "Package %s has now %i children.\n", package.name().characters(), m->children.size());
 #endif
         } else {
-            // search for package that provides this dependency in 'provides' attribute
-            package_db_for_machine(package.machine()).for_each_entry([&](auto&, auto& package_provides) {
-                if (package_provides.provides().size()) {
-                    for (auto& provides : package_provides.provides()) {
-                        for (auto& provide_value : provides.value) {
-                            if (provide_value == dependency.key) {
-                                if (package.machine() == package_provides.machine()) {
-                                    found_package = true;
-                                    m->children.append(get_dependency_tree(package_provides));
-                                    return IterationDecision::Break;
-                                }
-                            }
-                        }
-                    }
-                }
-                return IterationDecision::Continue;
-            });
+            fprintf(stderr, "Did not find %s, which is a dependency of %s!\n", dependency.name.characters(), package.name().characters());
+            m->missing_dependencies.append(dependency.name);
         }
+    }
 
-        if (!found_package && (package.machine() == MachineType::Host || package.machine() == MachineType::Build)) {
-            // When it's a host package, check the host machine (i.e. build machine), if the executable / library is existing
-            // This could (must!) be done in the generated code, but for now, we do it here.
-            // TODO: we can only check build tools for existence, move check of host tools into the host toolchain!
+    return m;
+}
+
+bool DependencyResolver::is_available_on_host(const String& name) const
+{
+    auto it = m_available_on_host.find(name);
+    if (it != m_available_on_host.end())
+        return (*it).value;
 
 #ifdef DEBUG_META
-            fprintf(stderr, "Checking for %s (which is a dependency of %s)\n", dependency.key.characters(), package.name().characters());
+    fprintf(stderr, "Checking for %s on the host\n", name.characters());
 #endif
+    bool available;
+    if (name.contains("lib"))
+        available = FileProvider::the().check_host_library_available(name);
+    else
+        available = FileProvider::the().check_host_command_available(name);
+    m_available_on_host.set(name, available);
+    return available;
+}
 
-            if (dependency.key.contains("lib")) {
-                if (FileProvider::the().check_host_library_available(dependency.key)) {
-                    found_package = true;
-                    const_cast<Package&>(package).remove_dependency(dependency.key);
-                }
-            } else {
-                if (FileProvider::the().check_host_command_available(dependency.key)) {
-                    found_package = true;
-                    const_cast<Package&>(package).remove_dependency(dependency.key);
-                }
-            }
+void DependencyResolver::probe_host_dependencies(PackageDB& db) const
+{
+    ProfileScope scope("probe host dependencies");
+    db.for_each_mutable_entry([&](auto&, auto& package) {
+        if (package.machine() != MachineType::Host && package.machine() != MachineType::Build)
+            return IterationDecision::Continue;
+
+        // When it's a host package, check the host machine (i.e. build machine), if the executable / library is existing
+        // This could (must!) be done in the generated code, but for now, we do it here.
+        // TODO: we can only check build tools for existence, move check of host tools into the host toolchain!
+        Vector<String> available_on_host;
+        for (auto& dependency : package.dependencies()) {
+            if (db.find_dependency(package, dependency.name))
+                continue;
+            if (is_available_on_host(dependency.name))
+                available_on_host.append(dependency.name);
         }
 
-        if (!found_package) {
-            fprintf(stderr, "Did not find %s, which is a dependency of %s!\n", dependency.key.characters(), package.name().characters());
-            m->missing_dependencies.append(dependency.key);
-        }
-    }
+        for (auto& name : available_on_host)
+            package.remove_dependency(name);
 
-    return m;
+        return IterationDecision::Continue;
+    });
+}
+
+void DependencyResolver::ensure_host_dependencies_probed()
+{
+    if (m_host_dependencies_probed)
+        return;
+    m_host_dependencies_probed = true;
+
+    PackageDB* databases[] = { &BuildPackageDB::the(), &HostPackageDB::the() };
+    for (auto* db : databases) {
+        db->thaw();
+        probe_host_dependencies(*db);
+        db->freeze();
+    }
 }
 
 const Vector<String> DependencyResolver::missing_dependencies(const DependencyNode* node) const
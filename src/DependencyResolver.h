@@ -1,6 +1,9 @@
 #pragma once
 
+#include "DataBase.h"
 #include "Package.h"
+#include "PackageDB.h"
+#include <AK/HashMap.h>
 #include <AK/NonnullOwnPtr.h>
 #include <LibCore/Object.h>
 
@@ -34,9 +37,21 @@ public:
     static DependencyResolver& the();
     ~DependencyResolver();
 
+    // removes dependencies of build and host packages that are satisfied by the host system, has to run before the DBs are frozen
+    void probe_host_dependencies(PackageDB&) const;
+    // probes the frozen build and host DBs on the first call. Probing starts a process per unknown
+    // name, so only the commands that resolve dependencies call it.
+    void ensure_host_dependencies_probed();
+
     NonnullOwnPtr<DependencyNode> get_dependency_tree(const Package& package) const;
     const Vector<String> missing_dependencies(const DependencyNode* node) const;
 
 private:
     DependencyResolver();
+
+    bool is_available_on_host(const String& name) const;
+
+    bool m_host_dependencies_probed { false };
+    // the result of every probe, names are often dependencies of many packages
+    mutable HashMap<String, bool> m_available_on_host;
 };
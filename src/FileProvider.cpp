@@ -1,5 +1,8 @@
 #include "FileProvider.h"
+#include "GlobCache.h"
+#include "Profiler.h"
 #include "SettingsProvider.h"
+#include <AK/QuickSort.h>
 #include <AK/StringBuilder.h>
 #include <LibCore/DirIterator.h>
 #include <sys/stat.h>
@@ -57,10 +60,11 @@ FileProvider& FileProvider::the()
 
 Vector<String> FileProvider::glob_all_meta_json_files(String root_directory)
 {
+    ProfileScope scope("find meta json files");
     Vector<String> skip_paths;
-    auto opt_build_dir = SettingsProvider::the().get("build_directory");
+    auto& opt_build_dir = SettingsProvider::the().build_directory();
     if (opt_build_dir.has_value()) {
-        skip_paths.append(opt_build_dir.value().as_string());
+        skip_paths.append(opt_build_dir.value());
     }
 
     return recursive_glob("**/*.m.json", root_directory, skip_paths);
@@ -152,27 +156,57 @@ static regex_t compile_regex(const StringView& pattern)
 
 Vector<String> FileProvider::recursive_glob(const StringView& pattern, const StringView& base)
 {
-    struct GlobState state;
-    state.base_dir = base;
-    state.skip_paths = {};
-    state.compiled_regex = compile_regex(pattern);
-    state.relative_regex = !pattern.starts_with("/");
-    state.pattern = pattern;
-    return recursive_glob(state, base);
+    return recursive_glob(pattern, base, {});
 }
 
 Vector<String> FileProvider::recursive_glob(const StringView& pattern, const StringView& base, Vector<String> skip_paths)
 {
+    StringBuilder key_builder;
+    key_builder.append(pattern);
+    key_builder.append('\n');
+    key_builder.append(base);
+    for (auto& skip_path : skip_paths) {
+        key_builder.append('\n');
+        key_builder.append(skip_path);
+    }
+    auto key = key_builder.build();
+
+    auto cached = GlobCache::the().lookup(key);
+    if (cached.has_value())
+        return cached.value();
+
+    Vector<DirectoryStamp> stamps;
+    auto files = expand_glob(pattern, base, move(skip_paths), stamps);
+
+    GlobCache::the().store(key, files, move(stamps));
+    return files;
+}
+
+Vector<String> FileProvider::expand_glob(const StringView& pattern, const StringView& base, Vector<String> skip_paths, Vector<DirectoryStamp>& stamps)
+{
+    ProfileScope scope("expand glob", base);
     struct GlobState state;
     state.base_dir = base;
-    state.skip_paths = skip_paths;
+    state.skip_paths = move(skip_paths);
     state.compiled_regex = compile_regex(pattern);
     state.relative_regex = !pattern.starts_with("/");
     state.pattern = pattern;
-    return recursive_glob(state, base);
+
+    stamps.append(GlobCache::stamp(state.base_dir));
+    return recursive_glob(state, base, stamps);
+}
+
+Vector<String> FileProvider::expand_glob_key(const String& key, Vector<DirectoryStamp>& stamps)
+{
+    auto parts = key.split('\n');
+    if (parts.size() < 2)
+        return {};
+    auto pattern = parts.take_first();
+    auto base = parts.take_first();
+    return expand_glob(pattern, base, move(parts), stamps);
 }
 
-Vector<String> FileProvider::recursive_glob(GlobState state, const StringView& current_dir)
+Vector<String> FileProvider::recursive_glob(const GlobState& state, const StringView& current_dir, Vector<DirectoryStamp>& stamps)
 {
     Core::DirIterator di(current_dir, Core::DirIterator::SkipDots);
     Vector<String> vec;
@@ -208,7 +242,8 @@ Vector<String> FileProvider::recursive_glob(GlobState state, const StringView& c
                 }
 
                 if (!skip) {
-                    vec.append(recursive_glob(state, new_path));
+                    stamps.append(GlobCache::stamp(new_path, st));
+                    vec.append(recursive_glob(state, new_path, stamps));
                 }
 
             } else {
@@ -291,8 +326,8 @@ const HashMap<String, String>& default_path_variables()
 {
     static HashMap<String, String> s_default_path_variables;
     if (s_default_path_variables.is_empty()) {
-        s_default_path_variables.set("root", SettingsProvider::the().get_string("root").value_or(""));
-        s_default_path_variables.set("gendata", SettingsProvider::the().get_string("gendata_directory").value_or(""));
+        s_default_path_variables.set("root", SettingsProvider::the().root().value_or(""));
+        s_default_path_variables.set("gendata", SettingsProvider::the().gendata_directory().value_or(""));
         s_default_path_variables.set("package_gendata", "");
     }
     return s_default_path_variables;
@@ -301,24 +336,18 @@ const HashMap<String, String>& default_path_variables()
 String FileProvider::replace_path_variables(const String& path, Function<Optional<String>(const String&)>* callback) const
 {
     if (potentially_contains_variable(path)) {
-        String result = path;
+        if (!callback)
+            return expand_variables(path, default_path_variables());
 
+        HashMap<String, String> variables;
         for (auto& it : default_path_variables()) {
-            if (callback) {
-                auto callback_value = (*callback)(it.key);
-                if (callback_value.has_value())
-                    result = replace_variables(result, it.key, callback_value.value());
-                else
-                    result = replace_variables(result, it.key, it.value);
-            } else {
-                auto a = result;
-                result = replace_variables(result, it.key, it.value);
+            auto callback_value = (*callback)(it.key);
+            variables.set(it.key, callback_value.has_value() ? callback_value.value() : it.value);
+        }
+        auto result = expand_variables(path, variables);
 #ifdef DEBUG_META
-                fprintf(stderr, "Replacing: %s with %s in %s = %s\n", it.key.characters(), it.value.characters(), a.characters(), result.characters());
+        fprintf(stderr, "Replacing variables in %s = %s\n", path.characters(), result.characters());
 #endif
-            }
-        }
-
         return result;
     } else
         return path;
@@ -331,6 +360,76 @@ String FileProvider::full_path_update(const String& path, const String& base, Fu
     return result;
 }
 
+static bool hash_file(const String& path, u64& hash)
+{
+    int fd = open(path.characters(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    char buffer[16384];
+    ssize_t nread;
+    while ((nread = read(fd, buffer, sizeof(buffer))) > 0)
+        hash = fnv1a_hash(StringView(buffer, nread), hash);
+    close(fd);
+    return nread == 0;
+}
+
+static void hash_tree(const String& directory, const String& relative_directory, const Vector<String>& skip_names, u64& hash)
+{
+    Core::DirIterator di(directory, Core::DirIterator::SkipDots);
+    if (di.has_error())
+        return;
+
+    // the order of directory entries is file system specific
+    Vector<String> names;
+    while (di.has_next())
+        names.append(di.next_path());
+    quick_sort(names.begin(), names.end(), [](auto& a, auto& b) {
+        return strcmp(a.characters(), b.characters()) < 0;
+    });
+
+    for (auto& name : names) {
+        if (skip_names.contains_slow(name))
+            continue;
+
+        StringBuilder path;
+        path.append(directory);
+        path.append("/");
+        path.append(name);
+        StringBuilder relative_path;
+        relative_path.append(relative_directory);
+        relative_path.append(name);
+
+        struct stat st;
+        if (lstat(path.build().characters(), &st) < 0)
+            continue;
+
+        hash = fnv1a_hash(relative_path.build(), hash);
+        hash = fnv1a_hash("\n", hash);
+        if (S_ISDIR(st.st_mode)) {
+            relative_path.append("/");
+            hash_tree(path.build(), relative_path.build(), skip_names, hash);
+        } else if (S_ISREG(st.st_mode) && !hash_file(path.build(), hash)) {
+            fprintf(stderr, "Could not read %s\n", path.build().characters());
+        }
+    }
+}
+
+u64 FileProvider::hash_file(const String& path)
+{
+    u64 hash = fnv1a_hash("");
+    if (!::hash_file(path, hash))
+        return 0;
+    return hash;
+}
+
+u64 FileProvider::hash_tree(const String& directory, const Vector<String>& skip_names)
+{
+    u64 hash = fnv1a_hash("");
+    ::hash_tree(directory, "", skip_names, hash);
+    return hash;
+}
+
 bool FileProvider::check_host_library_available(const String& library)
 {
     bool found = false;
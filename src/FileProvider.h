@@ -9,6 +9,8 @@
 #include <LibCore/Object.h>
 #include <regex.h>
 
+struct DirectoryStamp;
+
 bool create_dir(const String& path, const String& sub_dir = "");
 
 struct GlobState {
@@ -61,6 +63,16 @@ public:
     Vector<String> recursive_glob(const StringView& pattern, const StringView& base, Vector<String> skip_paths);
     Vector<String> glob(const StringView& pattern, const String& base);
 
+    // expands a glob without the glob cache, recording the walked directories
+    Vector<String> expand_glob(const StringView& pattern, const StringView& base, Vector<String> skip_paths, Vector<DirectoryStamp>& stamps);
+    // same for a key of the glob cache
+    Vector<String> expand_glob_key(const String& key, Vector<DirectoryStamp>& stamps);
+
+
+    // hash of the content of a file, 0 if it can't be read
+    u64 hash_file(const String& path);
+    // hash of the names and contents of all files below directory, skipping the given names
+    u64 hash_tree(const String& directory, const Vector<String>& skip_names);
 
     bool check_host_library_available(const String&);
     bool check_host_command_available(const String&);
@@ -78,5 +90,5 @@ private:
 
     String m_current_dir;
 
-    Vector<String> recursive_glob(GlobState state, const StringView& path);
+    Vector<String> recursive_glob(const GlobState& state, const StringView& path, Vector<DirectoryStamp>& stamps);
 };
@@ -0,0 +1,67 @@
+#include "GenerationStamp.h"
+#include "StringUtils.h"
+#include <AK/StringBuilder.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static String format_hash(u64 hash)
+{
+    StringBuilder builder;
+    builder.appendf("%08x%08x\n", (u32)(hash >> 32), (u32)hash);
+    return builder.build();
+}
+
+GenerationStamp::GenerationStamp(const String& directory, u64 input_hash)
+    : m_input_hash(input_hash)
+{
+    StringBuilder builder;
+    builder.append(directory);
+    builder.append("/.meta-stamp");
+    m_filename = builder.build();
+}
+
+bool GenerationStamp::is_current() const
+{
+    FILE* fd = fopen(m_filename.characters(), "r");
+    if (!fd)
+        return false;
+
+    char line[32];
+    bool current = fgets(line, sizeof(line), fd) && format_hash(m_input_hash) == line;
+    fclose(fd);
+    return current;
+}
+
+bool GenerationStamp::write() const
+{
+    FILE* fd = fopen(m_filename.characters(), "w");
+    if (!fd) {
+        perror("fopen");
+        return false;
+    }
+    auto content = format_hash(m_input_hash);
+    bool ok = fwrite(content.characters(), 1, content.length(), fd) == content.length();
+    if (fclose(fd) < 0)
+        ok = false;
+    if (!ok)
+        fprintf(stderr, "Could not write %s\n", m_filename.characters());
+    return ok;
+}
+
+u64 GenerationStamp::meta_version()
+{
+    static u64 s_version = 0;
+    if (s_version)
+        return s_version;
+
+    // a rebuilt or reinstalled binary gets a new inode or mtime
+    u64 hash = fnv1a_hash("meta");
+    struct stat st;
+    if (stat("/proc/self/exe", &st) == 0) {
+        u64 values[] = { (u64)st.st_ino, (u64)st.st_size, (u64)st.st_mtim.tv_sec, (u64)st.st_mtim.tv_nsec };
+        hash = fnv1a_hash(StringView((const char*)values, sizeof(values)), hash);
+    }
+    s_version = hash;
+    return s_version;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <AK/String.h>
+#include <AK/Types.h>
+
+// Hash of the inputs a part of the gendata directory (the root, the toolchain, an image or
+// a package) was generated from, kept as .meta-stamp next to the generated files. The part
+// is up to date as long as the stamp matches the hash of its current inputs.
+class GenerationStamp {
+public:
+    GenerationStamp(const String& directory, u64 input_hash);
+
+    const String& filename() const { return m_filename; }
+    bool is_current() const;
+    bool write() const;
+
+    // identifies the meta binary, a different generator may generate different files
+    static u64 meta_version();
+
+private:
+    String m_filename;
+    u64 m_input_hash;
+};
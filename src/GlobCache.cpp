@@ -0,0 +1,258 @@
+#include "GlobCache.h"
+#include "Profiler.h"
+#include <AK/HashTable.h>
+#include <AK/StringBuilder.h>
+#include <stdio.h>
+#include <time.h>
+
+static constexpr const char* s_magic = "METAGLOB";
+static constexpr u32 s_version = 2;
+
+static String cache_filename(const String& directory)
+{
+    StringBuilder builder;
+    builder.append(directory);
+    builder.append("/.meta-glob-cache");
+    return builder.build();
+}
+
+GlobCache& GlobCache::the()
+{
+    static GlobCache* s_the;
+    if (!s_the)
+        s_the = new GlobCache;
+    return *s_the;
+}
+
+GlobCache::GlobCache()
+{
+}
+
+DirectoryStamp GlobCache::stamp(const String& path)
+{
+    struct stat st;
+    if (stat(path.characters(), &st) < 0)
+        return { path, 0, 0, 0 };
+    return stamp(path, st);
+}
+
+DirectoryStamp GlobCache::stamp(const String& path, const struct stat& st)
+{
+    return { path, st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_ino };
+}
+
+void GlobCache::load(const String& directory)
+{
+    if (!m_enabled || directory.is_empty())
+        return;
+    ProfileScope scope("load glob cache");
+    m_directory = directory;
+
+    auto filename = cache_filename(directory);
+    m_file = MappedBinaryFile::map(filename, s_magic, s_version);
+    if (!m_file)
+        return;
+
+    auto reader = m_file->reader();
+    u32 entry_count = reader.read_value<u32>();
+    for (u32 i = 0; i < entry_count; ++i) {
+        size_t entry_offset = reader.offset();
+        String key;
+        if (!decode_entry(reader, &key, nullptr)) {
+            fprintf(stderr, "Glob cache %s is corrupt, ignoring it.\n", filename.characters());
+            m_mapped_entries.clear();
+            return;
+        }
+        m_mapped_entries.set(key, entry_offset);
+    }
+}
+
+bool GlobCache::decode_entry(BinaryReader& reader, String* key, Entry* entry) const
+{
+    if (key)
+        *key = reader.read_string();
+    else
+        reader.skip_string();
+
+    u32 stamp_count = reader.read_value<u32>();
+    for (u32 i = 0; i < stamp_count && !reader.has_error(); ++i) {
+        DirectoryStamp stamp;
+        if (entry)
+            stamp.path = reader.read_string();
+        else
+            reader.skip_string();
+        stamp.mtime_sec = reader.read_value<i64>();
+        stamp.mtime_nsec = reader.read_value<i64>();
+        stamp.inode = reader.read_value<u64>();
+        if (entry)
+            entry->stamps.append(move(stamp));
+    }
+
+    u32 file_count = reader.read_value<u32>();
+    for (u32 i = 0; i < file_count && !reader.has_error(); ++i) {
+        if (entry)
+            entry->files.append(reader.read_string());
+        else
+            reader.skip_string();
+    }
+    return !reader.has_error();
+}
+
+bool GlobCache::is_valid(const Vector<DirectoryStamp>& stamps)
+{
+    for (auto& expected : stamps) {
+        auto current = stamp(expected.path);
+        if (current.inode != expected.inode || current.mtime_sec != expected.mtime_sec || current.mtime_nsec != expected.mtime_nsec)
+            return false;
+    }
+    return true;
+}
+
+Optional<Vector<String>> GlobCache::lookup(const String& key)
+{
+    if (!m_enabled)
+        return {};
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        ++m_hits;
+        return (*it).value.files;
+    }
+
+    auto mapped = m_mapped_entries.find(key);
+    if (mapped != m_mapped_entries.end()) {
+        auto reader = m_file->reader((*mapped).value);
+        Entry entry;
+        if (decode_entry(reader, nullptr, &entry) && is_valid(entry.stamps)) {
+            entry.stable = true;
+            ++m_hits;
+            auto files = entry.files;
+            m_entries.set(key, move(entry));
+            return files;
+        }
+    }
+
+    ++m_misses;
+    return {};
+}
+
+void GlobCache::store(const String& key, const Vector<String>& files, Vector<DirectoryStamp>&& stamps)
+{
+    // A directory changed within the last second may change again without a visible
+    // mtime difference on file systems with coarse timestamps. Don't save it yet.
+    time_t now = time(nullptr);
+    bool stable = true;
+    for (auto& stamp : stamps) {
+        if (stamp.inode && stamp.mtime_sec >= now - 1) {
+            stable = false;
+            break;
+        }
+    }
+
+    m_directories_scanned += stamps.size();
+    m_entries.set(key, { files, move(stamps), stable });
+    if (stable)
+        m_dirty = true;
+}
+
+Vector<String> GlobCache::directories() const
+{
+    HashTable<String> seen;
+    Vector<String> directories;
+    for (auto& it : m_entries) {
+        for (auto& stamp : it.value.stamps) {
+            if (!stamp.inode || seen.contains(stamp.path))
+                continue;
+            seen.set(stamp.path);
+            directories.append(stamp.path);
+        }
+    }
+    return directories;
+}
+
+Vector<String> GlobCache::keys_for_directory(const String& path) const
+{
+    Vector<String> keys;
+    for (auto& it : m_entries) {
+        for (auto& stamp : it.value.stamps) {
+            if (stamp.path == path) {
+                keys.append(it.key);
+                break;
+            }
+        }
+    }
+    return keys;
+}
+
+Vector<String> GlobCache::keys() const
+{
+    Vector<String> keys;
+    for (auto& it : m_entries)
+        keys.append(it.key);
+    return keys;
+}
+
+bool GlobCache::is_stable() const
+{
+    for (auto& it : m_entries) {
+        if (!it.value.stable)
+            return false;
+    }
+    return true;
+}
+
+Optional<Vector<String>> GlobCache::files(const String& key) const
+{
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+        return {};
+    return (*it).value.files;
+}
+
+void GlobCache::save()
+{
+    if (!m_enabled || m_directory.is_empty())
+        return;
+
+#ifdef DEBUG_META
+    fprintf(stderr, "Glob cache: %u hits, %u misses\n", m_hits, m_misses);
+#endif
+
+    size_t stable_count = 0;
+    for (auto& it : m_entries) {
+        if (it.value.stable)
+            ++stable_count;
+    }
+
+    // entries that were not used by this run are dropped
+    if (stable_count != m_mapped_entries.size())
+        m_dirty = true;
+    if (!m_dirty)
+        return;
+    ProfileScope scope("save glob cache");
+
+    // the gendata directory is created by generating, its existence marks a generated tree
+    struct stat st;
+    if (stat(m_directory.characters(), &st) < 0 || !S_ISDIR(st.st_mode))
+        return;
+
+    BinaryWriter writer;
+    writer.write_value((u32)stable_count);
+    for (auto& it : m_entries) {
+        if (!it.value.stable)
+            continue;
+        writer.write_string(it.key);
+        writer.write_value((u32)it.value.stamps.size());
+        for (auto& stamp : it.value.stamps) {
+            writer.write_string(stamp.path);
+            writer.write_value(stamp.mtime_sec);
+            writer.write_value(stamp.mtime_nsec);
+            writer.write_value(stamp.inode);
+        }
+        writer.write_strings(it.value.files);
+    }
+
+    if (!writer.write_file(cache_filename(m_directory), s_magic, s_version))
+        return;
+    m_dirty = false;
+}
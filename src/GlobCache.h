@@ -0,0 +1,73 @@
+#pragma once
+
+#include "BinaryFile.h"
+#include <AK/HashMap.h>
+#include <AK/Optional.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <sys/stat.h>
+
+struct DirectoryStamp {
+    String path;
+    i64 mtime_sec;
+    i64 mtime_nsec;
+    u64 inode; // 0 if the directory did not exist
+};
+
+// Persistent cache for the results of recursive globs, stored as binary file in the
+// gendata directory. A result stays valid as long as none of the directories that were
+// walked to produce it has changed, which costs one stat per directory instead of a
+// readdir, a stat and a regex match per file.
+class GlobCache {
+public:
+    static GlobCache& the();
+
+    void load(const String& directory);
+    void save();
+    void disable() { m_enabled = false; }
+    bool is_enabled() const { return m_enabled; }
+
+    Optional<Vector<String>> lookup(const String& key);
+    void store(const String& key, const Vector<String>& files, Vector<DirectoryStamp>&& stamps);
+
+    // the globs expanded by this run, also recorded if the cache is disabled, for "meta serve"
+    Vector<String> directories() const;
+    Vector<String> keys_for_directory(const String& path) const;
+    Optional<Vector<String>> files(const String& key) const;
+    Vector<String> keys() const;
+    // false if a walked directory changed too recently to be cached
+    bool is_stable() const;
+
+    u32 hits() const { return m_hits; }
+    u32 misses() const { return m_misses; }
+    // directories walked to expand the globs that were not cached
+    u32 directories_scanned() const { return m_directories_scanned; }
+
+    static DirectoryStamp stamp(const String& path);
+    static DirectoryStamp stamp(const String& path, const struct stat&);
+
+private:
+    GlobCache();
+
+    struct Entry {
+        Vector<String> files;
+        Vector<DirectoryStamp> stamps;
+        bool stable;
+    };
+
+    bool decode_entry(BinaryReader&, String* key, Entry* entry) const;
+    static bool is_valid(const Vector<DirectoryStamp>&);
+
+    bool m_enabled { true };
+    bool m_dirty { false };
+    String m_directory;
+    OwnPtr<MappedBinaryFile> m_file;
+    u32 m_hits { 0 };
+    u32 m_misses { 0 };
+    u32 m_directories_scanned { 0 };
+
+    // entries of the mapped cache file, by offset into the mapping
+    HashMap<String, size_t> m_mapped_entries;
+    // entries used by this run, only the stable ones are written back
+    HashMap<String, Entry> m_entries;
+};
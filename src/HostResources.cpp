@@ -0,0 +1,148 @@
+#include "HostResources.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace HostResources {
+
+static bool read_file(const char* path, char* buffer, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    ssize_t nread = read(fd, buffer, size - 1);
+    close(fd);
+    if (nread <= 0)
+        return false;
+    buffer[nread] = '\0';
+    return true;
+}
+
+static bool read_number(const char* path, u64& number)
+{
+    char buffer[64];
+    unsigned long long value;
+    if (!read_file(path, buffer, sizeof(buffer)) || sscanf(buffer, "%llu", &value) != 1)
+        return false;
+    number = value;
+    return true;
+}
+
+// CPU quota of the cgroup in CPUs, rounded up, 0 if there is no quota
+static u32 cgroup_cpu_quota()
+{
+    char buffer[64];
+    long long quota;
+    unsigned long long period;
+
+    // cgroup v2: "<quota> <period>" or "max <period>"
+    if (read_file("/sys/fs/cgroup/cpu.max", buffer, sizeof(buffer))) {
+        if (sscanf(buffer, "%lld %llu", &quota, &period) == 2 && quota > 0 && period > 0)
+            return (quota + period - 1) / period;
+        return 0;
+    }
+
+    // cgroup v1: a quota of -1 means unlimited
+    if (read_file("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", buffer, sizeof(buffer))
+        && sscanf(buffer, "%lld", &quota) == 1 && quota > 0) {
+        u64 period_us;
+        if (read_number("/sys/fs/cgroup/cpu/cpu.cfs_period_us", period_us) && period_us > 0)
+            return (quota + period_us - 1) / period_us;
+    }
+    return 0;
+}
+
+// memory left in the cgroup in bytes, 0 if there is no limit
+static u64 cgroup_memory_left()
+{
+    u64 limit;
+    u64 usage = 0;
+    if (read_number("/sys/fs/cgroup/memory.max", limit)) {
+        read_number("/sys/fs/cgroup/memory.current", usage);
+    } else if (read_number("/sys/fs/cgroup/memory/memory.limit_in_bytes", limit)) {
+        // without a limit, cgroup v1 reports a value close to the maximum
+        if (limit >= (1ULL << 60))
+            return 0;
+        read_number("/sys/fs/cgroup/memory/memory.usage_in_bytes", usage);
+    } else {
+        return 0;
+    }
+    return limit > usage ? limit - usage : 1;
+}
+
+u32 usable_cpus()
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    u32 cpus = online > 0 ? online : 1;
+
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        u32 allowed = CPU_COUNT(&set);
+        if (allowed && allowed < cpus)
+            cpus = allowed;
+    }
+
+    u32 quota = cgroup_cpu_quota();
+    if (quota && quota < cpus)
+        cpus = quota;
+
+    return cpus;
+}
+
+u64 available_memory_mb()
+{
+    u64 available = 0;
+
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo) {
+        char line[128];
+        unsigned long long kb;
+        while (fgets(line, sizeof(line), meminfo)) {
+            if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) {
+                available = kb * 1024;
+                break;
+            }
+        }
+        fclose(meminfo);
+    }
+
+    u64 cgroup_left = cgroup_memory_left();
+    if (cgroup_left && (!available || cgroup_left < available))
+        available = cgroup_left;
+
+    return available / (1024 * 1024);
+}
+
+// The available memory changes between two runs of meta, but the job counts end up in the
+// CMake configure command. They are rounded down to quarters of the CPUs, so that a build
+// is only configured again when the memory changed a lot.
+static u32 memory_limited_jobs(u64 jobs, u32 limit, u32 cpus)
+{
+    if (jobs >= limit)
+        return limit;
+    u32 bucket = cpus / 4 ? cpus / 4 : 1;
+    if (jobs >= bucket)
+        return jobs / bucket * bucket;
+    return jobs < 1 ? 1 : jobs;
+}
+
+Jobs automatic_jobs(u64 memory_per_compile_job_mb, u64 memory_per_link_job_mb)
+{
+    u32 cpus = usable_cpus();
+    Jobs jobs { cpus, cpus };
+
+    u64 memory = available_memory_mb();
+    if (!memory)
+        return jobs;
+
+    if (memory_per_compile_job_mb)
+        jobs.compile = memory_limited_jobs(memory / memory_per_compile_job_mb, cpus, cpus);
+    jobs.link = jobs.compile;
+    if (memory_per_link_job_mb)
+        jobs.link = memory_limited_jobs(memory / memory_per_link_job_mb, jobs.compile, cpus);
+    return jobs;
+}
+
+}
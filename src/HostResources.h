@@ -0,0 +1,22 @@
+#pragma once
+
+#include <AK/Types.h>
+
+// What the build host offers to a build started by meta, taking the CPU affinity and
+// the limits of the cgroup meta runs in into account, e.g. on containerized build agents.
+namespace HostResources {
+
+u32 usable_cpus();
+
+// available memory in MiB, 0 if unknown
+u64 available_memory_mb();
+
+struct Jobs {
+    u32 compile;
+    u32 link;
+};
+
+// parallel jobs for the available CPUs, each compile and link job needs the given memory
+Jobs automatic_jobs(u64 memory_per_compile_job_mb, u64 memory_per_link_job_mb);
+
+}
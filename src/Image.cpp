@@ -1,4 +1,5 @@
 #include "Image.h"
+#include "BinaryFile.h"
 #include "StringUtils.h"
 
 InstallDir Image::string_to_install_dir(String type)
@@ -65,7 +66,7 @@ const String Image::install_dir_to_string(InstallDir installDir)
     return "Undefined";
 }
 
-Image::Image(const String& name, const String& filename, JsonObject json_obj)
+Image::Image(const String& name, const String& filename, const JsonObject& json_obj)
     : m_name(name)
     , m_filename(filename)
 {
@@ -109,10 +110,41 @@ Image::Image(const String& name, const String& filename, JsonObject json_obj)
     });
 }
 
+Image::Image(const String& name, BinaryReader& reader)
+    : m_name(name)
+{
+    m_filename = reader.read_string();
+    m_install = reader.read_strings();
+    m_install_all = reader.read_value<bool>();
+    m_build_tool = reader.read_string();
+    m_run_tool = reader.read_string();
+    u32 install_dir_count = reader.read_value<u32>();
+    for (u32 i = 0; i < install_dir_count && !reader.has_error(); ++i) {
+        auto install_dir = reader.read_value<InstallDir>();
+        m_install_dirs.set(install_dir, reader.read_string());
+    }
+    m_install_prefix = reader.read_string();
+}
+
 Image::~Image()
 {
 }
 
+void Image::write(BinaryWriter& writer) const
+{
+    writer.write_string(m_filename);
+    writer.write_strings(m_install);
+    writer.write_value(m_install_all);
+    writer.write_string(m_build_tool);
+    writer.write_string(m_run_tool);
+    writer.write_value((u32)m_install_dirs.size());
+    for (auto& it : m_install_dirs) {
+        writer.write_value(it.key);
+        writer.write_string(it.value);
+    }
+    writer.write_string(m_install_prefix);
+}
+
 void Image::set_default_install_dirs()
 {
     m_install_prefix = "/usr";
@@ -4,6 +4,9 @@
 #include <AK/JsonValue.h>
 #include <AK/String.h>
 
+class BinaryReader;
+class BinaryWriter;
+
 enum class InstallDir : uint8_t {
     Undefined,
     BinDir,
@@ -33,8 +36,11 @@ struct Traits<InstallDir> : public GenericTraits<InstallDir> {
 class Image {
 
 public:
-    Image(const String&, const String&, JsonObject);
+    Image(const String&, const String&, const JsonObject&);
+    // from the model cache
+    Image(const String&, BinaryReader&);
     ~Image();
+    void write(BinaryWriter&) const;
 
     const String& filename() const { return m_filename; }
     const String& name() const { return m_name; }
@@ -0,0 +1,217 @@
+#include "ModelCache.h"
+#include "BinaryFile.h"
+#include "FileProvider.h"
+#include "GenerationStamp.h"
+#include "GlobCache.h"
+#include "ImageDB.h"
+#include "PackageDB.h"
+#include "Profiler.h"
+#include "ToolchainDB.h"
+#include <AK/JsonValue.h>
+#include <AK/StringBuilder.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static constexpr const char* s_magic = "METAMODL";
+static constexpr u32 s_version = 2;
+
+static String cache_filename(const String& directory)
+{
+    StringBuilder builder;
+    builder.append(directory);
+    builder.append("/.meta-model-cache");
+    return builder.build();
+}
+
+struct InputStamp {
+    i64 mtime_sec;
+    i64 mtime_nsec;
+    i64 size;
+};
+
+static InputStamp input_stamp(const String& filename)
+{
+    struct stat st;
+    if (stat(filename.characters(), &st) < 0)
+        return { 0, 0, -1 };
+    return { st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_size };
+}
+
+// everything the model depends on besides the meta json files and the globs
+static Vector<String> environment()
+{
+    StringBuilder version;
+    version.appendf("%llx", (unsigned long long)GenerationStamp::meta_version());
+
+    Vector<String> environment;
+    environment.append(version.build());
+    environment.append(FileProvider::the().current_dir());
+    environment.append(SettingsProvider::the().root().value_or(""));
+    environment.append(SettingsProvider::the().build_directory().value_or(""));
+    environment.append(SettingsProvider::the().gendata_directory().value_or(""));
+    return environment;
+}
+
+ModelCache& ModelCache::the()
+{
+    static ModelCache* s_the;
+    if (!s_the)
+        s_the = new ModelCache;
+    return *s_the;
+}
+
+ModelCache::ModelCache()
+{
+}
+
+void ModelCache::add_settings(const String& filename, SettingsPriority priority, const JsonObject& settings)
+{
+    m_settings.append({ filename, priority, settings.to_string() });
+}
+
+bool ModelCache::has_settings(const String& filename) const
+{
+    for (auto& it : m_settings) {
+        if (it.filename == filename)
+            return true;
+    }
+    return false;
+}
+
+template<typename DB>
+static void write_database(BinaryWriter& writer, const DB& db)
+{
+    writer.write_value((u32)db.size());
+    db.for_each_entry([&](auto& name, auto& entry) {
+        writer.write_string(name);
+        entry.write(writer);
+        return IterationDecision::Continue;
+    });
+}
+
+template<typename DB>
+static bool read_database(BinaryReader& reader, DB& db)
+{
+    u32 count = reader.read_value<u32>();
+    for (u32 i = 0; i < count && !reader.has_error(); ++i)
+        db.add(reader.read_string(), reader);
+    return !reader.has_error();
+}
+
+bool ModelCache::load(const String& directory, const Vector<String>& files)
+{
+    if (!GlobCache::the().is_enabled() || directory.is_empty())
+        return false;
+    ProfileScope scope("load model cache");
+
+    auto file = MappedBinaryFile::map(cache_filename(directory), s_magic, s_version);
+    if (!file)
+        return false;
+    auto reader = file->reader();
+
+    auto expected_environment = environment();
+    auto stored_environment = reader.read_strings();
+    if (stored_environment.size() != expected_environment.size())
+        return false;
+    for (size_t i = 0; i < expected_environment.size(); ++i) {
+        if (stored_environment[i] != expected_environment[i])
+            return false;
+    }
+
+    u32 file_count = reader.read_value<u32>();
+    if (file_count != files.size())
+        return false;
+    for (auto& filename : files) {
+        auto stamp = input_stamp(filename);
+        if (reader.read_string() != filename || reader.read_value<i64>() != stamp.mtime_sec
+            || reader.read_value<i64>() != stamp.mtime_nsec || reader.read_value<i64>() != stamp.size)
+            return false;
+    }
+
+    // the globs are checked last, a lookup stats the directories that were walked
+    for (auto& key : reader.read_strings()) {
+        if (!GlobCache::the().lookup(key).has_value())
+            return false;
+    }
+
+    Vector<RecordedSettings> settings;
+    u32 settings_count = reader.read_value<u32>();
+    for (u32 i = 0; i < settings_count && !reader.has_error(); ++i) {
+        auto filename = reader.read_string();
+        auto priority = reader.read_value<SettingsPriority>();
+        settings.append({ filename, priority, reader.read_string() });
+    }
+
+    bool ok = !reader.has_error() && read_database(reader, ToolchainDB::the()) && read_database(reader, ImageDB::the())
+        && read_database(reader, BuildPackageDB::the()) && read_database(reader, HostPackageDB::the())
+        && read_database(reader, TargetPackageDB::the()) && reader.at_end();
+    if (!ok) {
+        fprintf(stderr, "Model cache %s could not be read, loading the meta json files.\n", cache_filename(directory).characters());
+        ToolchainDB::the().clear();
+        ImageDB::the().clear();
+        BuildPackageDB::the().clear();
+        HostPackageDB::the().clear();
+        TargetPackageDB::the().clear();
+        return false;
+    }
+
+    for (auto& it : settings) {
+        auto json = JsonValue::from_string(it.json);
+        if (json.is_object())
+            SettingsProvider::the().add(it.filename, it.priority, json.as_object());
+    }
+    m_settings = move(settings);
+    return true;
+}
+
+void ModelCache::save(const String& directory, const Vector<String>& files)
+{
+    if (!GlobCache::the().is_enabled() || directory.is_empty())
+        return;
+
+    // the gendata directory is created by generating, its existence marks a generated tree
+    struct stat st;
+    if (stat(directory.characters(), &st) < 0 || !S_ISDIR(st.st_mode))
+        return;
+
+    // Like the GlobCache, don't save inputs that changed within the last second, they may
+    // change again without a visible mtime difference on file systems with coarse timestamps.
+    if (!GlobCache::the().is_stable())
+        return;
+    time_t now = time(nullptr);
+    Vector<InputStamp> stamps;
+    for (auto& filename : files) {
+        auto stamp = input_stamp(filename);
+        if (stamp.mtime_sec >= now - 1)
+            return;
+        stamps.append(stamp);
+    }
+    ProfileScope scope("save model cache");
+
+    BinaryWriter writer;
+    writer.write_strings(environment());
+    writer.write_value((u32)files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        writer.write_string(files[i]);
+        writer.write_value(stamps[i].mtime_sec);
+        writer.write_value(stamps[i].mtime_nsec);
+        writer.write_value(stamps[i].size);
+    }
+    writer.write_strings(GlobCache::the().keys());
+
+    writer.write_value((u32)m_settings.size());
+    for (auto& it : m_settings) {
+        writer.write_string(it.filename);
+        writer.write_value(it.priority);
+        writer.write_string(it.json);
+    }
+
+    write_database(writer, ToolchainDB::the());
+    write_database(writer, ImageDB::the());
+    write_database(writer, BuildPackageDB::the());
+    write_database(writer, HostPackageDB::the());
+    write_database(writer, TargetPackageDB::the());
+
+    writer.write_file(cache_filename(directory), s_magic, s_version);
+}
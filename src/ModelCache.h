@@ -0,0 +1,34 @@
+#pragma once
+
+#include "SettingsProvider.h"
+#include <AK/JsonObject.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+
+// Snapshot of the loaded model, i.e. the toolchains, images and packages of all machines,
+// stored as binary file in the gendata directory. As long as no meta json file changed and
+// every glob the packages expanded is still valid in the GlobCache, the databases are
+// filled from the snapshot instead of parsing the json files and constructing the packages.
+class ModelCache {
+public:
+    static ModelCache& the();
+
+    // settings of the meta json files, they are applied again when loading the snapshot
+    void add_settings(const String& filename, SettingsPriority, const JsonObject&);
+    bool has_settings(const String& filename) const;
+
+    // true if the databases were filled from the snapshot, false if they are still empty
+    bool load(const String& directory, const Vector<String>& files);
+    void save(const String& directory, const Vector<String>& files);
+
+private:
+    ModelCache();
+
+    struct RecordedSettings {
+        String filename;
+        SettingsPriority priority;
+        String json;
+    };
+
+    Vector<RecordedSettings> m_settings;
+};
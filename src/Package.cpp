@@ -1,4 +1,5 @@
 #include "Package.h"
+#include "BinaryFile.h"
 #include "FileProvider.h"
 #include "SettingsProvider.h"
 
@@ -106,15 +107,45 @@ DeploymentPermission Package::parse_permission(const String& permission)
     return res;
 }
 
-Package::Package(const String& name, const String& filename, MachineType machine, const JsonObject& json_obj)
-    : m_name(name)
+PackageDetailsTable& PackageDetailsTable::the()
+{
+    static PackageDetailsTable* s_the;
+    if (!s_the)
+        s_the = new PackageDetailsTable;
+    return *s_the;
+}
+
+u32 PackageDetailsTable::allocate_id()
+{
+    m_details.append(nullptr);
+    return m_details.size() - 1;
+}
+
+PackageDetails& PackageDetailsTable::ensure(u32 id)
+{
+    ASSERT(id < m_details.size());
+    if (!m_details[id])
+        m_details[id] = make<PackageDetails>();
+    return *m_details[id];
+}
+
+const PackageDetails& PackageDetailsTable::get(u32 id) const
+{
+    if (id >= m_details.size() || !m_details[id])
+        return m_empty;
+    return *m_details[id];
+}
+
+Package::Package(const String& name, const String& filename, MachineType machine, const JsonObject& json_obj, const JsonObject* machine_overrides)
+    : m_id(PackageDetailsTable::the().allocate_id())
+    , m_name(name)
     , m_filename(filename)
     , m_machine(machine)
 {
     FileSystemPath path { filename };
     m_directory = path.dirname();
 
-    json_obj.for_each_member([&](auto& key, auto& value) {
+    auto parse_member = [&](auto& key, auto& value) {
         if (key == "type") {
             if (value.as_string().matches("library"))
                 m_type = PackageType::Library;
@@ -169,7 +200,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                     else if (key.matches("collection"))
                         type = PackageType::Collection;
 
-                    m_provides.set(type, values);
+                    set_provides(type, values);
                 });
             }
             return;
@@ -180,7 +211,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                 value.as_object().for_each_member([&](auto& key, auto& value) {
                     if (key == "steps") {
                         if (value.is_array()) {
-                            auto values = value.as_array().values();
+                            auto& values = value.as_array().values();
                             for (auto& step_value : values) {
                                 m_toolchain_steps.append(step_value.as_string());
                             }
@@ -190,7 +221,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                     if (key == "options") {
                         if (value.is_object()) {
                             value.as_object().for_each_member([&](auto& key, auto& value) {
-                                m_toolchain_options.set(key, value.as_object());
+                                ensure_details().toolchain_options.set(key, value.as_object());
                             });
                         }
                         return;
@@ -219,20 +250,20 @@ Package::Package(const String& name, const String& filename, MachineType machine
             // },
 
             if (value.is_array()) {
-                auto values = value.as_array().values();
+                auto& values = value.as_array().values();
                 for (auto& value : values) {
-                    m_dependencies.set(value.as_string(), LinkageType::Inherit);
+                    set_dependency(value.as_string(), LinkageType::Inherit);
                 }
             } else if (value.is_object()) {
                 value.as_object().for_each_member([&](auto& key, auto& value) {
-                    m_dependencies.set(key, string_to_linkage_type(value.as_string()));
+                    set_dependency(key, string_to_linkage_type(value.as_string()));
                 });
             }
             return;
         }
 
         StringBuilder b;
-        b.append(SettingsProvider::the().get_string("gendata_directory").value_or(""));
+        b.append(SettingsProvider::the().gendata_directory().value_or(""));
         b.append("/${image}");
         auto package_gendata_dir = b.build();
 
@@ -244,7 +275,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
         };
 
         if (key == "source") {
-            auto values = value.as_array().values();
+            auto& values = value.as_array().values();
             for (auto& value : values) {
                 String source = FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata);
                 String search_dir = m_directory;
@@ -253,24 +284,24 @@ Package::Package(const String& name, const String& filename, MachineType machine
                     // get the last path element, before the glob sign occurs
                     search_dir = get_max_path_without_glob(source);
                     if (search_dir.is_empty()) {
-                        search_dir = SettingsProvider::the().get_string("root").value_or("");
+                        search_dir = SettingsProvider::the().root().value_or("");
                     }
                     auto files = FileProvider::the().recursive_glob(source, search_dir);
                     for (auto& file : files) {
-                        m_sources.append(file);
+                        m_sources.append(PathStore::the().intern(file));
                     }
                 } else
-                    m_sources.append(source);
+                    m_sources.append(PathStore::the().intern(source));
             }
 #ifdef DEBUG_META
             for (auto& source : m_sources) {
-                fprintf(stdout, "source: %s\n", source.characters());
+                fprintf(stdout, "source: %s\n", PathStore::the().path(source).characters());
             }
 #endif
             return;
         }
         if (key == "include") {
-            auto values = value.as_array().values();
+            auto& values = value.as_array().values();
             for (auto& value : values) {
                 String include = FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata);
                 String search_dir = m_directory;
@@ -279,24 +310,92 @@ Package::Package(const String& name, const String& filename, MachineType machine
                     // get the last path element, before the glob sign occurs
                     search_dir = get_max_path_without_glob(include);
                     if (search_dir.is_empty()) {
-                        search_dir = SettingsProvider::the().get_string("root").value_or("");
+                        search_dir = SettingsProvider::the().root().value_or("");
                     }
                     auto files = FileProvider::the().recursive_glob(include, search_dir);
                     for (auto& file : files) {
-                        m_sources.append(file);
+                        m_sources.append(PathStore::the().intern(file));
                     }
                 } else
-                    m_includes.append(include);
+                    m_includes.append(PathStore::the().intern(include));
             }
 #ifdef DEBUG_META
             for (auto& include : m_includes) {
-                fprintf(stdout, "include: %s\n", include.characters());
+                fprintf(stdout, "include: %s\n", PathStore::the().path(include).characters());
             }
 #endif
             return;
         }
+        if (key == "unity_build") {
+            // "unity_build": false | <batch size> | { "batch_size": <batch size>, "exclude": [...] }
+            if (value.is_bool()) {
+                if (!value.as_bool())
+                    m_unity_build_batch_size = 0;
+            } else if (value.is_u32()) {
+                m_unity_build_batch_size = value.as_u32();
+            } else if (value.is_object()) {
+                auto& obj = value.as_object();
+                if (obj.get("batch_size").is_u32())
+                    m_unity_build_batch_size = obj.get("batch_size").as_u32();
+
+                JsonArray single_value;
+                const JsonArray* values = &single_value;
+                auto* exclude_value = obj.get_ptr("exclude");
+                if (exclude_value && exclude_value->is_string()) {
+                    single_value.append(exclude_value->as_string());
+                } else if (exclude_value && exclude_value->is_array()) {
+                    values = &exclude_value->as_array();
+                }
+                for (auto& value : values->values()) {
+                    String exclude = FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata);
+
+                    if (is_glob(exclude)) {
+                        auto search_dir = get_max_path_without_glob(exclude);
+                        if (search_dir.is_empty()) {
+                            search_dir = SettingsProvider::the().root().value_or("");
+                        }
+                        auto files = FileProvider::the().recursive_glob(exclude, search_dir);
+                        for (auto& file : files) {
+                            m_unity_build_exclude.append(PathStore::the().intern(file));
+                        }
+                    } else
+                        m_unity_build_exclude.append(PathStore::the().intern(exclude));
+                }
+            } else {
+                fprintf(stderr, "Unknown value for unity_build in %s.\n", m_filename.characters());
+            }
+            return;
+        }
+        if (key == "memory_weight") {
+            if (value.is_u32() && value.as_u32() >= 1)
+                m_memory_weight = value.as_u32();
+            else
+                fprintf(stderr, "Invalid memory_weight in %s, must be an integer >= 1.\n", m_filename.characters());
+            return;
+        }
+        if (key == "precompiled_headers") {
+            // "precompiled_headers": "auto" | { "auto": <number of headers> } | [ "<AK/String.h>", "${root}/header.h", ... ]
+            if (value.is_string() && value.as_string() == "auto") {
+                m_precompiled_headers_auto = 8;
+            } else if (value.is_object()) {
+                if (value.as_object().get("auto").is_u32())
+                    m_precompiled_headers_auto = value.as_object().get("auto").as_u32();
+            } else if (value.is_array()) {
+                auto& values = value.as_array().values();
+                for (auto& value : values) {
+                    auto header = value.as_string();
+                    if (header.starts_with("<"))
+                        m_precompiled_headers.append(header);
+                    else
+                        m_precompiled_headers.append(FileProvider::the().full_path_update(header, m_directory, &replace_package_gendata));
+                }
+            } else {
+                fprintf(stderr, "Unknown value for precompiled_headers in %s.\n", m_filename.characters());
+            }
+            return;
+        }
         if (key == "deploy") {
-            auto values = value.as_array().values();
+            auto& values = value.as_array().values();
 
 #ifdef DEBUG_META
             fprintf(stderr, "Found %i install items for %s\n", values.size(), m_name.characters());
@@ -372,25 +471,27 @@ Package::Package(const String& name, const String& filename, MachineType machine
         if (key == "test") {
             if (value.is_object()) {
                 auto& obj = value.as_object();
-                if (obj.has("executable") && obj.get("executable").is_object()) {
+                auto* executables = obj.get_ptr("executable");
+                if (executables && executables->is_object()) {
                     auto test = adopt(*new Test());
-                    JsonObject executables_obj = obj.get("executable").as_object();
-                    executables_obj.for_each_member([&](auto& key, auto& value) {
+                    executables->as_object().for_each_member([&](auto& key, auto& value) {
                         TestExecutable test_executable(key);
 
                         if (value.is_object()) {
                             value.as_object().for_each_member([&](auto& key, auto& value) {
                                 if (key == "source") {
-                                    JsonArray values;
+                                    // a single string is wrapped, an array is used in place
+                                    JsonArray single_value;
+                                    const JsonArray* values = &single_value;
                                     if (value.is_string()) {
-                                        values.append(value.as_string());
+                                        single_value.append(value.as_string());
                                     } else if (value.is_array()) {
-                                        values = value.as_array();
+                                        values = &value.as_array();
                                     } else {
                                         fprintf(stderr, "Unknown type for test source values in %s.\n", m_filename.characters());
                                         return;
                                     }
-                                    for (auto& value : values.values()) {
+                                    for (auto& value : values->values()) {
                                         String source = FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata);
                                         String search_dir = m_directory;
 
@@ -398,7 +499,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                             // get the last path element, before the glob sign occurs
                                             search_dir = get_max_path_without_glob(source);
                                             if (search_dir.is_empty()) {
-                                                search_dir = SettingsProvider::the().get_string("root").value_or("");
+                                                search_dir = SettingsProvider::the().root().value_or("");
                                             }
                                             auto files = FileProvider::the().recursive_glob(source, search_dir);
                                             for (auto& file : files) {
@@ -408,23 +509,24 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                             test_executable.add_source(source);
                                     }
 #ifdef DEBUG_META
-                                    for (auto& source : m_sources) {
+                                    for (auto& source : test_executable.source()) {
                                         fprintf(stdout, "source: %s\n", source.characters());
                                     }
 #endif
                                     return;
                                 }
                                 if (key == "include") {
-                                    JsonArray values;
+                                    JsonArray single_value;
+                                    const JsonArray* values = &single_value;
                                     if (value.is_string()) {
-                                        values.append(value.as_string());
+                                        single_value.append(value.as_string());
                                     } else if (value.is_array()) {
-                                        values = value.as_array();
+                                        values = &value.as_array();
                                     } else {
                                         fprintf(stderr, "Unknown type for test include values in %s.\n", m_filename.characters());
                                         return;
                                     }
-                                    for (auto& value : values.values()) {
+                                    for (auto& value : values->values()) {
                                         String include = FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata);
                                         String search_dir = m_directory;
 
@@ -432,7 +534,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                             // get the last path element, before the glob sign occurs
                                             search_dir = get_max_path_without_glob(include);
                                             if (search_dir.is_empty()) {
-                                                search_dir = SettingsProvider::the().get_string("root").value_or("");
+                                                search_dir = SettingsProvider::the().root().value_or("");
                                             }
                                             auto files = FileProvider::the().recursive_glob(include, search_dir);
                                             for (auto& file : files) {
@@ -442,7 +544,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                             test_executable.add_include(include);
                                     }
 #ifdef DEBUG_META
-                                    for (auto& include : m_includes) {
+                                    for (auto& include : test_executable.include()) {
                                         fprintf(stdout, "include: %s\n", include.characters());
                                     }
 #endif
@@ -451,7 +553,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                 }
                                 if (key == "additional_dependency") {
                                     if (value.is_array()) {
-                                        auto values = value.as_array().values();
+                                        auto& values = value.as_array().values();
                                         for (auto& value : values) {
                                             test_executable.add_dependency(value.as_string(), LinkageType::Inherit);
                                         }
@@ -464,7 +566,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                 }
                                 if (key == "additional_resource") {
                                     if (value.is_array()) {
-                                        auto values = value.as_array().values();
+                                        auto& values = value.as_array().values();
                                         for (auto& value : values) {
                                             test_executable.add_resource(FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata));
                                         }
@@ -475,16 +577,17 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                 }
 
                                 if (key == "exclude_from_package_source") {
-                                    JsonArray values;
+                                    JsonArray single_value;
+                                    const JsonArray* values = &single_value;
                                     if (value.is_string()) {
-                                        values.append(value.as_string());
+                                        single_value.append(value.as_string());
                                     } else if (value.is_array()) {
-                                        values = value.as_array();
+                                        values = &value.as_array();
                                     } else {
                                         fprintf(stderr, "Unknown type for test exclude from package source values in %s.\n", m_filename.characters());
                                         return;
                                     }
-                                    for (auto& value : values.values()) {
+                                    for (auto& value : values->values()) {
                                         String exclude = FileProvider::the().full_path_update(value.as_string(), m_directory, &replace_package_gendata);
                                         String search_dir = m_directory;
 
@@ -492,7 +595,7 @@ Package::Package(const String& name, const String& filename, MachineType machine
                                             // get the last path element, before the glob sign occurs
                                             search_dir = get_max_path_without_glob(exclude);
                                             if (search_dir.is_empty()) {
-                                                search_dir = SettingsProvider::the().get_string("root").value_or("");
+                                                search_dir = SettingsProvider::the().root().value_or("");
                                             }
                                             auto files = FileProvider::the().recursive_glob(exclude, search_dir);
                                             for (auto& file : files) {
@@ -521,15 +624,15 @@ Package::Package(const String& name, const String& filename, MachineType machine
         }
 
         if (key == "target_tools") {
-            Toolchain::insert_tool(m_target_tools, value.as_object(), filename);
+            Toolchain::insert_tool(ensure_details().target_tools, value.as_object(), filename);
             return;
         }
         if (key == "build_tools") {
-            Toolchain::insert_tool(m_build_tools, value.as_object(), filename);
+            Toolchain::insert_tool(ensure_details().build_tools, value.as_object(), filename);
             return;
         }
         if (key == "host_tools") {
-            Toolchain::insert_tool(m_host_tools, value.as_object(), filename);
+            Toolchain::insert_tool(ensure_details().host_tools, value.as_object(), filename);
             return;
         }
         if (key == "run_generators") {
@@ -569,29 +672,303 @@ Package::Package(const String& name, const String& filename, MachineType machine
                         input_output_tuples.append(tuple);
                     }
 
-                    m_run_generators.set(key, { input_output_tuples });
+                    ensure_details().run_generators.set(key, { input_output_tuples });
                 });
             } else {
                 fprintf(stderr, "Unknown value for run_generators in %s.\n", m_filename.characters());
             }
             return;
         }
+    };
+
+    // members of the machine specific object override the ones of the package. They are parsed in the
+    // order of a merged object without building it: an overridden member at the position of the package's
+    // member, the members only the machine object has after all others.
+    json_obj.for_each_member([&](auto& key, auto& value) {
+        auto* override_value = machine_overrides ? machine_overrides->get_ptr(key) : nullptr;
+        parse_member(key, override_value ? *override_value : value);
     });
+    if (machine_overrides) {
+        machine_overrides->for_each_member([&](auto& key, auto& value) {
+            if (!json_obj.has(key))
+                parse_member(key, value);
+        });
+    }
 
     // fill test data after data of package is completed
     if (!m_test.is_null()) {
         for (auto& test_executable : m_test->executables()) {
             for (auto& dependency : m_dependencies) {
-                test_executable.add_dependency(dependency.key, dependency.value);
+                test_executable.add_dependency(dependency.name, dependency.linkage);
             }
             test_executable.add_dependency(m_name, LinkageType::Direct);
         }
     }
 }
 
+static void write_paths(BinaryWriter& writer, const Vector<PathId>& paths)
+{
+    writer.write_value((u32)paths.size());
+    for (auto id : paths)
+        writer.write_string(PathStore::the().path(id));
+}
+
+static Vector<PathId> read_paths(BinaryReader& reader)
+{
+    Vector<PathId> paths;
+    u32 count = reader.read_value<u32>();
+    paths.ensure_capacity(count);
+    for (u32 i = 0; i < count && !reader.has_error(); ++i)
+        paths.append(PathStore::the().intern(reader.read_string()));
+    return paths;
+}
+
+static void write_dependencies(BinaryWriter& writer, const HashMap<String, LinkageType>& dependencies)
+{
+    writer.write_value((u32)dependencies.size());
+    for (auto& it : dependencies) {
+        writer.write_string(it.key);
+        writer.write_value(it.value);
+    }
+}
+
+Package::Package(const String& name, BinaryReader& reader)
+    : m_id(PackageDetailsTable::the().allocate_id())
+    , m_name(name)
+{
+    m_filename = reader.read_string();
+    m_machine = reader.read_value<MachineType>();
+    m_consistent = reader.read_value<bool>();
+    m_directory = reader.read_string();
+    m_type = reader.read_value<PackageType>();
+
+    m_version.major = reader.read_value<int>();
+    if (reader.read_value<bool>())
+        m_version.minor = reader.read_value<int>();
+    if (reader.read_value<bool>())
+        m_version.bugfix = reader.read_value<int>();
+    m_version.other = reader.read_string();
+
+    u32 provides_count = reader.read_value<u32>();
+    for (u32 i = 0; i < provides_count && !reader.has_error(); ++i) {
+        auto type = reader.read_value<PackageType>();
+        m_provides.append({ type, reader.read_strings() });
+    }
+
+    m_sources = read_paths(reader);
+    m_includes = read_paths(reader);
+    m_toolchain_steps = reader.read_strings();
+
+    u32 dependency_count = reader.read_value<u32>();
+    for (u32 i = 0; i < dependency_count && !reader.has_error(); ++i) {
+        auto dependency_name = reader.read_string();
+        m_dependencies.append({ dependency_name, reader.read_value<LinkageType>() });
+    }
+    m_dependency_linkage = reader.read_value<LinkageType>();
+
+    u32 deploy_count = reader.read_value<u32>();
+    for (u32 i = 0; i < deploy_count && !reader.has_error(); ++i) {
+        auto deployment = adopt(*new Deployment(reader.read_value<DeploymentType>()));
+        deployment->set_name(reader.read_string());
+        deployment->set_source(reader.read_string());
+        deployment->set_rename(reader.read_string());
+        deployment->set_pattern(reader.read_string());
+        deployment->set_dest(reader.read_string());
+        deployment->set_symlink(reader.read_string());
+        if (reader.read_value<bool>())
+            deployment->set_permission(reader.read_value<DeploymentPermission>());
+        m_deploy.append(deployment);
+    }
+
+    if (reader.read_value<bool>()) {
+        auto test = adopt(*new Test());
+        u32 executable_count = reader.read_value<u32>();
+        for (u32 i = 0; i < executable_count && !reader.has_error(); ++i) {
+            TestExecutable test_executable(reader.read_string());
+            for (auto& source : reader.read_strings())
+                test_executable.add_source(source);
+            for (auto& include : reader.read_strings())
+                test_executable.add_include(include);
+            u32 test_dependency_count = reader.read_value<u32>();
+            for (u32 j = 0; j < test_dependency_count && !reader.has_error(); ++j) {
+                auto dependency_name = reader.read_string();
+                test_executable.add_dependency(dependency_name, reader.read_value<LinkageType>());
+            }
+            for (auto& exclude : reader.read_strings())
+                test_executable.add_exclude_from_package_source(exclude);
+            for (auto& resource : reader.read_strings())
+                test_executable.add_resource(resource);
+            test->add_executable(test_executable);
+        }
+        m_test = move(test);
+    }
+
+    if (reader.read_value<bool>())
+        m_unity_build_batch_size = reader.read_value<u32>();
+    m_unity_build_exclude = read_paths(reader);
+    m_precompiled_headers = reader.read_strings();
+    m_precompiled_headers_auto = reader.read_value<u32>();
+    m_memory_weight = reader.read_value<u32>();
+
+    if (!reader.read_value<bool>())
+        return;
+    auto& details = ensure_details();
+    u32 option_count = reader.read_value<u32>();
+    for (u32 i = 0; i < option_count && !reader.has_error(); ++i) {
+        auto option_name = reader.read_string();
+        auto options = JsonValue::from_string(reader.read_string());
+        details.toolchain_options.set(option_name, options.is_object() ? options.as_object() : JsonObject());
+    }
+    details.target_tools = Toolchain::read_tools(reader);
+    details.build_tools = Toolchain::read_tools(reader);
+    details.host_tools = Toolchain::read_tools(reader);
+    u32 generator_count = reader.read_value<u32>();
+    for (u32 i = 0; i < generator_count && !reader.has_error(); ++i) {
+        auto generator_name = reader.read_string();
+        Generator generator;
+        u32 tuple_count = reader.read_value<u32>();
+        for (u32 j = 0; j < tuple_count && !reader.has_error(); ++j) {
+            InputOutputTuple tuple;
+            tuple.input = reader.read_string();
+            tuple.output = reader.read_string();
+            tuple.flags = reader.read_string();
+            generator.input_output_tuples.append(tuple);
+        }
+        details.run_generators.set(generator_name, generator);
+    }
+}
+
 Package::~Package()
 {
 }
+
+void Package::write(BinaryWriter& writer) const
+{
+    writer.write_string(m_filename);
+    writer.write_value(m_machine);
+    writer.write_value(m_consistent);
+    writer.write_string(m_directory);
+    writer.write_value(m_type);
+
+    writer.write_value(m_version.major);
+    writer.write_value(m_version.minor.has_value());
+    if (m_version.minor.has_value())
+        writer.write_value(m_version.minor.value());
+    writer.write_value(m_version.bugfix.has_value());
+    if (m_version.bugfix.has_value())
+        writer.write_value(m_version.bugfix.value());
+    writer.write_string(m_version.other);
+
+    writer.write_value((u32)m_provides.size());
+    for (auto& provides : m_provides) {
+        writer.write_value(provides.type);
+        writer.write_strings(provides.names);
+    }
+
+    write_paths(writer, m_sources);
+    write_paths(writer, m_includes);
+    writer.write_strings(m_toolchain_steps);
+
+    writer.write_value((u32)m_dependencies.size());
+    for (auto& dependency : m_dependencies) {
+        writer.write_string(dependency.name);
+        writer.write_value(dependency.linkage);
+    }
+    writer.write_value(m_dependency_linkage);
+
+    writer.write_value((u32)m_deploy.size());
+    for (auto& deployment : m_deploy) {
+        writer.write_value(deployment->type());
+        writer.write_string(deployment->name());
+        writer.write_string(deployment->source());
+        writer.write_string(deployment->rename());
+        writer.write_string(deployment->pattern());
+        writer.write_string(deployment->dest());
+        writer.write_string(deployment->symlink());
+        writer.write_value(deployment->permission().has_value());
+        if (deployment->permission().has_value())
+            writer.write_value(deployment->permission().value());
+    }
+
+    // the test executables are written with the dependencies added after parsing
+    writer.write_value(!m_test.is_null());
+    if (!m_test.is_null()) {
+        writer.write_value((u32)m_test->executables().size());
+        for (auto& test_executable : m_test->executables()) {
+            writer.write_string(test_executable.name());
+            writer.write_strings(test_executable.source());
+            writer.write_strings(test_executable.include());
+            write_dependencies(writer, test_executable.dependency());
+            writer.write_strings(test_executable.exclude_from_package_source());
+            writer.write_strings(test_executable.resource());
+        }
+    }
+
+    writer.write_value(m_unity_build_batch_size.has_value());
+    if (m_unity_build_batch_size.has_value())
+        writer.write_value(m_unity_build_batch_size.value());
+    write_paths(writer, m_unity_build_exclude);
+    writer.write_strings(m_precompiled_headers);
+    writer.write_value(m_precompiled_headers_auto);
+    writer.write_value(m_memory_weight);
+
+    auto& details = this->details();
+    bool has_details = !details.toolchain_options.is_empty() || !details.target_tools.is_empty() || !details.build_tools.is_empty()
+        || !details.host_tools.is_empty() || !details.run_generators.is_empty();
+    writer.write_value(has_details);
+    if (!has_details)
+        return;
+    writer.write_value((u32)details.toolchain_options.size());
+    for (auto& it : details.toolchain_options) {
+        writer.write_string(it.key);
+        writer.write_string(it.value.to_string());
+    }
+    Toolchain::write_tools(writer, details.target_tools);
+    Toolchain::write_tools(writer, details.build_tools);
+    Toolchain::write_tools(writer, details.host_tools);
+    writer.write_value((u32)details.run_generators.size());
+    for (auto& it : details.run_generators) {
+        writer.write_string(it.key);
+        writer.write_value((u32)it.value.input_output_tuples.size());
+        for (auto& tuple : it.value.input_output_tuples) {
+            writer.write_string(tuple.input);
+            writer.write_string(tuple.output);
+            writer.write_string(tuple.flags);
+        }
+    }
+}
+void Package::set_dependency(const String& name, LinkageType linkage)
+{
+    for (auto& dependency : m_dependencies) {
+        if (dependency.name == name) {
+            dependency.linkage = linkage;
+            return;
+        }
+    }
+    m_dependencies.append({ name, linkage });
+}
+
+void Package::remove_dependency(const String& name)
+{
+    for (size_t i = 0; i < m_dependencies.size(); ++i) {
+        if (m_dependencies[i].name == name) {
+            m_dependencies.remove(i);
+            return;
+        }
+    }
+}
+
+void Package::set_provides(PackageType type, const Vector<String>& names)
+{
+    for (auto& provides : m_provides) {
+        if (provides.type == type) {
+            provides.names = names;
+            return;
+        }
+    }
+    m_provides.append({ type, names });
+}
+
 LinkageType Package::get_dependency_linkage(LinkageType type) const
 {
     if (type == LinkageType::Inherit) {
@@ -1,11 +1,17 @@
 #pragma once
 
+#include "PathStore.h"
 #include "Toolchain.h"
 #include <AK/JsonObject.h>
+#include <AK/Noncopyable.h>
+#include <AK/OwnPtr.h>
 #include <AK/Traits.h>
 #include <LibCore/Object.h>
 #include <string>
 
+class BinaryReader;
+class BinaryWriter;
+
 enum class LinkageType : uint8_t {
     Inherit = 0,
     Static,
@@ -172,16 +178,57 @@ struct Generator {
     Vector<InputOutputTuple> input_output_tuples;
 };
 
+struct PackageDependency {
+    String name;
+    LinkageType linkage;
+};
+
+struct PackageProvides {
+    PackageType type;
+    Vector<String> names;
+};
+
+using PackageDependencies = Vector<PackageDependency, 4>;
+using PackageProvidesList = Vector<PackageProvides, 1>;
+
+// Data that only few packages define. It is kept in the PackageDetailsTable, indexed by package id.
+struct PackageDetails {
+    HashMap<String, JsonObject> toolchain_options;
+    HashMap<String, Tool> target_tools;
+    HashMap<String, Tool> build_tools;
+    HashMap<String, Tool> host_tools;
+    HashMap<String, Generator> run_generators;
+};
+
+class PackageDetailsTable {
+public:
+    static PackageDetailsTable& the();
+
+    u32 allocate_id();
+    PackageDetails& ensure(u32 id);
+    const PackageDetails& get(u32 id) const;
+
+private:
+    PackageDetails m_empty;
+    Vector<OwnPtr<PackageDetails>> m_details;
+};
+
 class Package {
+    AK_MAKE_NONCOPYABLE(Package)
+    AK_MAKE_NONMOVABLE(Package)
 
 public:
-    Package(const String&, const String&, MachineType machine, const JsonObject&);
+    Package(const String&, const String&, MachineType machine, const JsonObject&, const JsonObject* machine_overrides = nullptr);
+    // from the model cache
+    Package(const String&, BinaryReader&);
     ~Package();
+    void write(BinaryWriter&) const;
 
     const Vector<String>& toolchain_steps() const { return m_toolchain_steps; }
-    const HashMap<String, JsonObject>& toolchain_options() const { return m_toolchain_options; }
-    const Vector<String>& sources() const { return m_sources; }
-    const Vector<String>& includes() const { return m_includes; }
+    const HashMap<String, JsonObject>& toolchain_options() const { return details().toolchain_options; }
+    // interned in the PathStore, use PathStore::the().path() to get the full path
+    const Vector<PathId>& sources() const { return m_sources; }
+    const Vector<PathId>& includes() const { return m_includes; }
     const String& name() const { return m_name; }
     PackageType type() const { return m_type; }
     const String& filename() const { return m_filename; }
@@ -221,26 +268,43 @@ public:
         }
     }
 
-    const HashMap<String, LinkageType>& dependencies() const { return m_dependencies; }
-    const HashMap<PackageType, Vector<String>>& provides() const { return m_provides; }
+    u32 id() const { return m_id; }
+
+    const PackageDependencies& dependencies() const { return m_dependencies; }
+    const PackageProvidesList& provides() const { return m_provides; }
     const Vector<NonnullRefPtr<Deployment>>& deploy() const { return m_deploy; }
 
     const RefPtr<Test>& test() const { return m_test; }
 
     LinkageType get_dependency_linkage(LinkageType) const;
 
-    const HashMap<String, Tool>& target_tools() const { return m_target_tools; }
-    const HashMap<String, Tool>& host_tools() const { return m_host_tools; }
-    const HashMap<String, Tool>& build_tools() const { return m_build_tools; }
+    const HashMap<String, Tool>& target_tools() const { return details().target_tools; }
+    const HashMap<String, Tool>& host_tools() const { return details().host_tools; }
+    const HashMap<String, Tool>& build_tools() const { return details().build_tools; }
 
-    const HashMap<String, Generator>& run_generators() const { return m_run_generators; }
+    const HashMap<String, Generator>& run_generators() const { return details().run_generators; }
 
-    void remove_dependency(const String& name)
-    {
-        m_dependencies.remove(name);
-    }
+    // An empty value means the global unity build setting is used, 0 disables unity build for the package
+    const Optional<u32>& unity_build_batch_size() const { return m_unity_build_batch_size; }
+    const Vector<PathId>& unity_build_exclude() const { return m_unity_build_exclude; }
+
+    const Vector<String>& precompiled_headers() const { return m_precompiled_headers; }
+    // Number of headers that are automatically selected from the sources, 0 if disabled
+    u32 precompiled_headers_auto() const { return m_precompiled_headers_auto; }
+
+    // Memory needed per compile or link job relative to an average package, at least 1
+    u32 memory_weight() const { return m_memory_weight; }
+
+    void remove_dependency(const String& name);
 
 private:
+    const PackageDetails& details() const { return PackageDetailsTable::the().get(m_id); }
+    PackageDetails& ensure_details() { return PackageDetailsTable::the().ensure(m_id); }
+
+    void set_dependency(const String& name, LinkageType);
+    void set_provides(PackageType, const Vector<String>&);
+
+    u32 m_id;
     String m_name;
     String m_filename;
     MachineType m_machine;
@@ -255,23 +319,23 @@ private:
     PackageVersion m_version;
 
     // For collections, provide the ability to define which libraries and executables are contained.
-    HashMap<PackageType, Vector<String>> m_provides;
+    PackageProvidesList m_provides;
 
-    Vector<String> m_sources;
-    Vector<String> m_includes;
+    Vector<PathId> m_sources;
+    Vector<PathId> m_includes;
 
     Vector<String> m_toolchain_steps;
-    HashMap<String, JsonObject> m_toolchain_options;
 
-    HashMap<String, LinkageType> m_dependencies;
+    PackageDependencies m_dependencies;
     LinkageType m_dependency_linkage = LinkageType::Static;
 
     Vector<NonnullRefPtr<Deployment>> m_deploy;
     RefPtr<Test> m_test;
 
-    HashMap<String, Tool> m_target_tools;
-    HashMap<String, Tool> m_build_tools;
-    HashMap<String, Tool> m_host_tools;
+    Optional<u32> m_unity_build_batch_size;
+    Vector<PathId> m_unity_build_exclude;
 
-    HashMap<String, Generator> m_run_generators;
+    Vector<String> m_precompiled_headers;
+    u32 m_precompiled_headers_auto = 0;
+    u32 m_memory_weight = 1;
 };
@@ -17,9 +17,9 @@ MachineType machine_to_machine_type(const String& machine)
     return m;
 }
 
-Package* PackageDB::find_package_that_provides(const String& executable)
+const Package* PackageDB::find_package_that_provides(const String& executable) const
 {
-    Package* ret { nullptr };
+    const Package* ret { nullptr };
     for_each_entry([&](auto& name, auto& package) {
         if (package.type() == PackageType::Executable && name == executable) {
             ret = &package;
@@ -27,7 +27,7 @@ Package* PackageDB::find_package_that_provides(const String& executable)
         }
 
         for (auto& provides : package.provides()) {
-            for (auto& provide_value : provides.value) {
+            for (auto& provide_value : provides.names) {
                 if (provide_value == executable) {
                     ret = &package;
                     return IterationDecision::Break;
@@ -40,7 +40,62 @@ Package* PackageDB::find_package_that_provides(const String& executable)
     return ret;
 }
 
-DataBase<Package>& package_db_for_machine(MachineType machine)
+const Package* PackageDB::find_dependency(const Package& package, const String& name) const
+{
+    if (auto* dependency = get(name))
+        return dependency;
+
+    const Package* provider { nullptr };
+    for_each_entry([&](auto&, auto& candidate) {
+        if (candidate.machine() != package.machine())
+            return IterationDecision::Continue;
+        for (auto& provides : candidate.provides()) {
+            if (provides.names.contains_slow(name)) {
+                provider = &candidate;
+                return IterationDecision::Break;
+            }
+        }
+        return IterationDecision::Continue;
+    });
+    return provider;
+}
+
+void PackageDB::visit_in_dependency_order(const Package& package, HashTable<const Package*>& visited, Vector<const Package*>& order) const
+{
+    if (visited.contains(&package))
+        return;
+    // mark before descending, so circular dependencies terminate
+    visited.set(&package);
+
+    for (auto& dependency : package.dependencies()) {
+        if (auto* dependency_package = find_dependency(package, dependency.name))
+            visit_in_dependency_order(*dependency_package, visited, order);
+    }
+    order.append(&package);
+}
+
+Vector<const Package*> PackageDB::packages_in_dependency_order() const
+{
+    HashTable<const Package*> visited;
+    Vector<const Package*> order;
+    for_each_entry([&](auto&, auto& package) {
+        visit_in_dependency_order(package, visited, order);
+        return IterationDecision::Continue;
+    });
+    return order;
+}
+
+u32 PackageDB::max_memory_weight() const
+{
+    u32 weight = 1;
+    for_each_entry([&](auto&, auto& package) {
+        weight = max(weight, package.memory_weight());
+        return IterationDecision::Continue;
+    });
+    return weight;
+}
+
+PackageDB& package_db_for_machine(MachineType machine)
 {
     ASSERT(machine != MachineType::Undefined);
 
@@ -57,27 +112,22 @@ DataBase<Package>& package_db_for_machine(MachineType machine)
 bool add_package(const String& name, const String& filename, const JsonObject& json_obj)
 {
     bool ret = true;
-    auto machine_json = json_obj.get("machine");
+    auto* machine_json = json_obj.get_ptr("machine");
     Vector<MachineType> machines;
 
-    if (machine_json.is_object()) {
-        machine_json.as_object().for_each_member([&](auto& key, auto& value) {
+    if (machine_json && machine_json->is_object()) {
+        machine_json->as_object().for_each_member([&](auto& key, auto& value) {
             auto machine = machine_to_machine_type(key);
-            auto merged_json_obj = json_obj;
-            value.as_object().for_each_member([&](auto& key, auto& value) {
-                merged_json_obj.set(key, value);
-            });
-
-            package_db_for_machine(machine).add(name, filename, machine, merged_json_obj);
+            package_db_for_machine(machine).add(name, filename, machine, json_obj, &value.as_object());
         });
 
     } else {
-        if (machine_json.is_array()) {
-            for (auto machine : machine_json.as_array().values()) {
+        if (machine_json && machine_json->is_array()) {
+            for (auto& machine : machine_json->as_array().values()) {
                 machines.append(machine_to_machine_type(machine.as_string()));
             }
         } else {
-            machines.append(machine_to_machine_type(machine_json.as_string_or("target")));
+            machines.append(machine_to_machine_type(machine_json ? machine_json->as_string_or("target") : "target"));
         }
 
         // insert package into each machine specific database
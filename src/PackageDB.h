@@ -5,7 +5,28 @@
 
 class PackageDB : public DataBase<Package> {
 public:
-    Package* find_package_that_provides(const String& executable);
+    const Package* find_package_that_provides(const String& executable) const;
+
+    // Each package is visited after the packages it depends on, independent packages in name order.
+    template<typename Callback>
+    void for_each_entry_in_dependency_order(Callback callback) const
+    {
+        for (auto* package : packages_in_dependency_order()) {
+            if (callback(package->name(), *package) == IterationDecision::Break)
+                break;
+        }
+    }
+
+    Vector<const Package*> packages_in_dependency_order() const;
+
+    // the package with the name or providing it, for the machine of the package
+    const Package* find_dependency(const Package&, const String& name) const;
+
+    // the largest memory_weight of all packages, 1 if no package declares one
+    u32 max_memory_weight() const;
+
+private:
+    void visit_in_dependency_order(const Package&, HashTable<const Package*>& visited, Vector<const Package*>& order) const;
 };
 
 class BuildPackageDB : public PackageDB {
@@ -41,6 +62,6 @@ public:
     }
 };
 
-DataBase<Package>& package_db_for_machine(MachineType);
+PackageDB& package_db_for_machine(MachineType);
 
 bool add_package(const String&, const String&, const JsonObject&);
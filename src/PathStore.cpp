@@ -0,0 +1,65 @@
+#include "PathStore.h"
+#include <AK/StringBuilder.h>
+
+PathStore& PathStore::the()
+{
+    static PathStore* s_the;
+    if (!s_the)
+        s_the = new PathStore;
+    return *s_the;
+}
+
+PathStore::PathStore()
+{
+    m_nodes.append({ absolute_root, "" });
+    m_nodes.append({ relative_root, "" });
+}
+
+PathId PathStore::intern(const StringView& path)
+{
+    PathId current = relative_root;
+    StringView components = path;
+    if (path.starts_with("/")) {
+        current = absolute_root;
+        components = path.substring_view(1, path.length() - 1);
+    }
+    if (components.is_empty())
+        return current;
+
+    // empty components keep repeated and trailing slashes
+    for (auto& part : components.split_view('/', true)) {
+        PathKey key { current, String(part) };
+        auto it = m_children.find(key);
+        if (it != m_children.end()) {
+            current = (*it).value;
+            continue;
+        }
+
+        PathId id = m_nodes.size();
+        m_nodes.append({ current, key.name });
+        m_children.set(move(key), id);
+        current = id;
+    }
+
+    return current;
+}
+
+String PathStore::path(PathId id) const
+{
+    Vector<PathId, 16> components;
+    while (!is_root(id)) {
+        components.append(id);
+        id = m_nodes[id].parent;
+    }
+
+    if (components.is_empty())
+        return id == absolute_root ? "/" : ".";
+
+    StringBuilder builder;
+    for (size_t i = components.size(); i > 0; --i) {
+        if (i != components.size() || id == absolute_root)
+            builder.append('/');
+        builder.append(m_nodes[components[i - 1]].name);
+    }
+    return builder.build();
+}
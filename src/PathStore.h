@@ -0,0 +1,56 @@
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+
+using PathId = u32;
+
+struct PathKey {
+    PathId parent;
+    String name;
+
+    bool operator==(const PathKey& other) const { return parent == other.parent && name == other.name; }
+};
+
+namespace AK {
+template<>
+struct Traits<PathKey> : public GenericTraits<PathKey> {
+    static unsigned hash(const PathKey& key) { return pair_int_hash(key.parent, key.name.hash()); }
+    static void dump(const PathKey& key) { kprintf("%u/%s", key.parent, key.name.characters()); }
+};
+}
+
+// Interns paths component wise, every directory is stored once as parent id + name.
+// Paths are only materialized as String, when they are written out. They are stored
+// verbatim: "." and ".." can't be resolved lexically after a symlink or at the start
+// of a relative path, and repeated or trailing slashes are kept as empty components.
+class PathStore {
+public:
+    static PathStore& the();
+
+    static constexpr PathId absolute_root = 0;
+    static constexpr PathId relative_root = 1;
+
+    PathId intern(const StringView& path);
+
+    PathId parent(PathId id) const { return m_nodes[id].parent; }
+    const String& name(PathId id) const { return m_nodes[id].name; }
+    bool is_root(PathId id) const { return id == absolute_root || id == relative_root; }
+    // a path with a trailing slash ends with an empty component
+    PathId without_trailing_slash(PathId id) const { return !is_root(id) && m_nodes[id].name.is_empty() ? m_nodes[id].parent : id; }
+
+    String path(PathId) const;
+    size_t size() const { return m_nodes.size(); }
+
+private:
+    PathStore();
+
+    struct Node {
+        PathId parent;
+        String name;
+    };
+
+    Vector<Node> m_nodes;
+    HashMap<PathKey, PathId> m_children;
+};
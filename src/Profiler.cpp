@@ -0,0 +1,176 @@
+#include "Profiler.h"
+#include <AK/HashMap.h>
+#include <AK/QuickSort.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+Profiler& Profiler::the()
+{
+    static Profiler* s_the;
+    if (!s_the)
+        s_the = new Profiler;
+    return *s_the;
+}
+
+Profiler::Profiler()
+{
+}
+
+u64 Profiler::now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void Profiler::enable()
+{
+    if (!m_enabled)
+        m_start_us = now_us();
+    m_enabled = true;
+}
+
+void Profiler::enable_summary()
+{
+    enable();
+    m_summary = true;
+}
+
+void Profiler::enable_trace(const String& filename)
+{
+    enable();
+    m_trace_filename = filename;
+}
+
+void Profiler::begin(const char* name)
+{
+    m_open_scopes.append({ name, 0 });
+}
+
+void Profiler::end(const char* name, const String& detail, u64 start_us)
+{
+    u64 duration_us = now_us() - start_us;
+    u64 child_us = m_open_scopes.take_last().child_us;
+
+    // the time of a scope nested in one of the same name is already part of the outer total
+    bool nested = false;
+    for (auto& scope : m_open_scopes) {
+        if (!strcmp(scope.name, name))
+            nested = true;
+    }
+    if (!m_open_scopes.is_empty())
+        m_open_scopes.last().child_us += duration_us;
+
+    m_events.append({ name, detail, start_us, duration_us, duration_us - child_us, nested });
+}
+
+void Profiler::report()
+{
+    if (!m_enabled)
+        return;
+    if (m_summary)
+        print_summary();
+    if (!m_trace_filename.is_empty())
+        write_trace();
+}
+
+Vector<Profiler::PhaseTotal> Profiler::phase_totals() const
+{
+    HashMap<String, size_t> row_index;
+    Vector<PhaseTotal> rows;
+    for (auto& event : m_events) {
+        String name = event.name;
+        auto it = row_index.find(name);
+        if (it == row_index.end()) {
+            row_index.set(name, rows.size());
+            rows.append({ name, 0, 0, 0, 0 });
+            it = row_index.find(name);
+        }
+        auto& row = rows[(*it).value];
+        ++row.calls;
+        row.self_us += event.self_us;
+        if (event.duration_us > row.max_us)
+            row.max_us = event.duration_us;
+        if (!event.nested)
+            row.total_us += event.duration_us;
+    }
+    quick_sort(rows.begin(), rows.end(), [](auto& a, auto& b) {
+        return a.total_us > b.total_us;
+    });
+    return rows;
+}
+
+void Profiler::print_summary() const
+{
+    auto rows = phase_totals();
+    u64 wall_us = now_us() - m_start_us;
+    fprintf(stderr, "Profile (%.1f ms wall time):\n", wall_us / 1000.0);
+    fprintf(stderr, "  %-32s %8s %11s %11s %11s\n", "phase", "calls", "total ms", "self ms", "max ms");
+    for (auto& row : rows) {
+        fprintf(stderr, "  %-32s %8u %11.1f %11.1f %11.1f\n", row.name.characters(), row.calls,
+            row.total_us / 1000.0, row.self_us / 1000.0, row.max_us / 1000.0);
+    }
+
+    Vector<const Event*> detailed;
+    for (auto& event : m_events) {
+        if (!event.detail.is_empty())
+            detailed.append(&event);
+    }
+    if (detailed.is_empty())
+        return;
+    quick_sort(detailed.begin(), detailed.end(), [](auto& a, auto& b) {
+        return a->duration_us > b->duration_us;
+    });
+    fprintf(stderr, "Slowest:\n");
+    for (size_t i = 0; i < detailed.size() && i < 10; ++i) {
+        fprintf(stderr, "  %-20s %-40s %9.1f ms\n", detailed[i]->name, detailed[i]->detail.characters(),
+            detailed[i]->duration_us / 1000.0);
+    }
+}
+
+static void write_json_string(FILE* file, const char* string)
+{
+    fputc('"', file);
+    for (const char* c = string; *c; ++c) {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char)*c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Chrome trace event format, open it in chrome://tracing or https://ui.perfetto.dev
+void Profiler::write_trace() const
+{
+    FILE* file = fopen(m_trace_filename.characters(), "w");
+    if (!file) {
+        fprintf(stderr, "Could not write trace %s: %s\n", m_trace_filename.characters(), strerror(errno));
+        return;
+    }
+
+    int pid = getpid();
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"meta\"}}", pid);
+    for (auto& event : m_events) {
+        fprintf(file, ",\n{\"name\":");
+        write_json_string(file, event.name);
+        fprintf(file, ",\"cat\":\"meta\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":1",
+            (unsigned long long)(event.start_us - m_start_us), (unsigned long long)event.duration_us, pid);
+        if (!event.detail.is_empty()) {
+            fprintf(file, ",\"args\":{\"detail\":");
+            write_json_string(file, event.detail.characters());
+            fputc('}', file);
+        }
+        fputc('}', file);
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0)
+        fprintf(stderr, "Could not write trace %s\n", m_trace_filename.characters());
+}
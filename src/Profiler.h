@@ -0,0 +1,91 @@
+#pragma once
+
+#include <AK/String.h>
+#include <AK/Vector.h>
+
+// Scoped timers for the phases of a meta run. Nothing is recorded unless --profile or
+// --trace enabled the profiler, a disabled ProfileScope only checks a flag.
+class Profiler {
+public:
+    static Profiler& the();
+
+    bool is_enabled() const { return m_enabled; }
+    // records the scopes without reporting them, for phase_totals()
+    void enable();
+    void enable_summary();
+    void enable_trace(const String& filename);
+
+    void begin(const char* name);
+    void end(const char* name, const String& detail, u64 start_us);
+
+    // prints the summary table to stderr and writes the trace file, if enabled
+    void report();
+
+    struct PhaseTotal {
+        String name;
+        u32 calls;
+        u64 total_us;
+        u64 self_us;
+        u64 max_us;
+    };
+    // recorded scopes grouped by name, longest total first
+    Vector<PhaseTotal> phase_totals() const;
+
+    static u64 now_us();
+
+private:
+    Profiler();
+
+    struct Event {
+        const char* name;
+        String detail;
+        u64 start_us;
+        u64 duration_us;
+        u64 self_us;
+        bool nested;
+    };
+
+    void print_summary() const;
+    void write_trace() const;
+
+    bool m_enabled { false };
+    bool m_summary { false };
+    String m_trace_filename;
+    u64 m_start_us { 0 };
+    Vector<Event> m_events;
+
+    struct OpenScope {
+        const char* name;
+        u64 child_us; // time spent in scopes nested in this one
+    };
+    Vector<OpenScope> m_open_scopes;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : ProfileScope(name, String())
+    {
+    }
+
+    ProfileScope(const char* name, const String& detail)
+        : m_name(name)
+    {
+        if (!Profiler::the().is_enabled())
+            return;
+        m_detail = detail;
+        m_start_us = Profiler::now_us();
+        Profiler::the().begin(name);
+    }
+
+    ~ProfileScope()
+    {
+        if (m_start_us)
+            Profiler::the().end(m_name, m_detail, m_start_us);
+    }
+
+private:
+    const char* m_name;
+    String m_detail;
+    u64 m_start_us { 0 };
+};
@@ -0,0 +1,543 @@
+#include "Server.h"
+#include "FileProvider.h"
+#include "GlobCache.h"
+#include "SettingsProvider.h"
+#include <AK/FileSystemPath.h>
+#include <AK/HashMap.h>
+#include <AK/HashTable.h>
+#include <AK/QuickSort.h>
+#include <AK/StringBuilder.h>
+#include <LibCore/EventLoop.h>
+#include <LibCore/LocalServer.h>
+#include <LibCore/LocalSocket.h>
+#include <LibCore/Notifier.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Server {
+
+// sent instead of a pid if the server does not run the command, the client runs it itself
+static constexpr i32 s_not_served = -1;
+static constexpr u32 s_max_request_size = 1024 * 1024;
+
+static constexpr u32 s_watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+    | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+// variables the loaded model depends on, host dependencies are probed with the PATH
+static const char* s_model_environment[] = { "PATH" };
+
+static int s_inotify_fd = -1;
+static HashMap<int, String> s_watched_directories;
+static HashTable<String> s_watched_paths;
+static volatile pid_t s_remote_pid = 0;
+
+String socket_path()
+{
+    auto gendata = SettingsProvider::the().gendata_directory();
+    if (!gendata.has_value())
+        return {};
+    StringBuilder builder;
+    builder.append(gendata.value());
+    builder.append("/.meta-server.sock");
+    return builder.build();
+}
+
+static void set_blocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && (flags & O_NONBLOCK))
+        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+}
+
+static bool write_all(int fd, const void* data, size_t size)
+{
+    auto* bytes = (const char*)data;
+    while (size) {
+        ssize_t nwritten = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (nwritten < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += nwritten;
+        size -= nwritten;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void* data, size_t size)
+{
+    auto* bytes = (char*)data;
+    while (size) {
+        ssize_t nread = read(fd, bytes, size);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return false;
+        bytes += nread;
+        size -= nread;
+    }
+    return true;
+}
+
+// the request starts with its length, which carries the standard file descriptors of the client
+static bool send_descriptors(int socket_fd, u32 length)
+{
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov = { &length, sizeof(length) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    auto* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    ssize_t nwritten;
+    do {
+        nwritten = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+    } while (nwritten < 0 && errno == EINTR);
+    return nwritten == sizeof(length);
+}
+
+static bool receive_descriptors(int socket_fd, u32& length, int (&fds)[3])
+{
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { &length, sizeof(length) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t nread;
+    do {
+        nread = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+    } while (nread < 0 && errno == EINTR);
+    if (nread != sizeof(length) || (message.msg_flags & MSG_CTRUNC))
+        return false;
+
+    auto* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS
+        || header->cmsg_len != CMSG_LEN(sizeof(fds)))
+        return false;
+    memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    return true;
+}
+
+static void forward_signal(int signal_number)
+{
+    if (s_remote_pid > 0)
+        kill(-s_remote_pid, signal_number);
+}
+
+Optional<int> forward(int argc, char** argv)
+{
+    auto path = socket_path();
+    struct stat st;
+    if (path.is_empty() || stat(path.characters(), &st) < 0 || !S_ISSOCK(st.st_mode))
+        return {};
+
+    auto socket = Core::LocalSocket::construct();
+    if (!socket->connect(Core::SocketAddress::local(path)))
+        return {};
+    int fd = socket->fd();
+    set_blocking(fd);
+
+    // "<current dir>\0<argc>\0<arg0>\0<arg1>...\0<NAME=value>\0<NAME=value>..."
+    StringBuilder builder;
+    builder.append(FileProvider::the().current_dir());
+    builder.append('\0');
+    builder.appendf("%d", argc);
+    for (int i = 0; i < argc; ++i) {
+        builder.append('\0');
+        builder.append(argv[i]);
+    }
+    for (char** variable = environ; *variable; ++variable) {
+        builder.append('\0');
+        builder.append(*variable);
+    }
+    auto request = builder.build();
+
+    if (!send_descriptors(fd, request.length()) || !write_all(fd, request.characters(), request.length()))
+        return {};
+
+    i32 pid;
+    if (!read_all(fd, &pid, sizeof(pid)) || pid == s_not_served)
+        return {};
+
+    // the command runs in its own process group, Ctrl-C only reaches this process
+    s_remote_pid = pid;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = forward_signal;
+    sigemptyset(&action.sa_mask);
+    int signals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT };
+    for (int signal_number : signals)
+        sigaction(signal_number, &action, nullptr);
+
+    i32 exit_code;
+    if (!read_all(fd, &exit_code, sizeof(exit_code))) {
+        fprintf(stderr, "The meta server closed the connection.\n");
+        return 1;
+    }
+    return exit_code;
+}
+
+static const char* find_variable(const Vector<char*>& environment, const char* name)
+{
+    size_t length = strlen(name);
+    for (auto* variable : environment) {
+        if (!strncmp(variable, name, length) && variable[length] == '=')
+            return variable + length + 1;
+    }
+    return nullptr;
+}
+
+static bool has_model_environment(const Vector<char*>& client_environment)
+{
+    for (auto* name : s_model_environment) {
+        const char* value = getenv(name);
+        const char* client_value = find_variable(client_environment, name);
+        if (!value != !client_value || (value && strcmp(value, client_value)))
+            return false;
+    }
+    return true;
+}
+
+// runs in the forked child of the server
+static int run_request(int socket_fd, Function<int(int, char**)>& execute)
+{
+    signal(SIGCHLD, SIG_DFL);
+    setpgid(0, 0);
+    set_blocking(socket_fd);
+
+    u32 length;
+    int fds[3];
+    if (!receive_descriptors(socket_fd, length, fds) || length > s_max_request_size)
+        return 1;
+
+    Vector<char> request;
+    request.resize(length + 1);
+    if (!read_all(socket_fd, request.data(), length))
+        return 1;
+    request[length] = '\0';
+
+    Vector<char*> strings;
+    for (u32 i = 0; i < length; ++i) {
+        if (request[i] == '\0')
+            strings.append(&request[i + 1]);
+    }
+    const char* client_dir = request.data();
+    int argc = strings.is_empty() ? -1 : atoi(strings[0]);
+    if (argc < 0 || (size_t)argc >= strings.size())
+        return 1;
+
+    Vector<char*> arguments;
+    for (int i = 1; i <= argc; ++i)
+        arguments.append(strings[i]);
+    arguments.append(nullptr);
+    Vector<char*> client_environment;
+    for (size_t i = argc + 1; i < strings.size(); ++i)
+        client_environment.append(strings[i]);
+
+    // the model was loaded for the directory and the environment of the server
+    if (FileProvider::the().current_dir() != client_dir || !has_model_environment(client_environment)) {
+        i32 not_served = s_not_served;
+        write_all(socket_fd, &not_served, sizeof(not_served));
+        return 0;
+    }
+
+    // the command and the tools it runs see the environment of the client
+    clearenv();
+    for (auto* variable : client_environment)
+        putenv(variable);
+
+    for (int i = 0; i < 3; ++i) {
+        if (fds[i] == i)
+            continue;
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+    setvbuf(stdout, nullptr, isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF, BUFSIZ);
+
+    i32 pid = getpid();
+    if (!write_all(socket_fd, &pid, sizeof(pid)))
+        return 1;
+
+    i32 exit_code = execute(arguments.size() - 1, arguments.data());
+    fflush(stdout);
+    fflush(stderr);
+    write_all(socket_fd, &exit_code, sizeof(exit_code));
+    return exit_code;
+}
+
+[[noreturn]] static void reload(char** original_argv)
+{
+    fprintf(stderr, "meta serve: the model changed, reloading\n");
+    fflush(stdout);
+    fflush(stderr);
+    execv("/proc/self/exe", original_argv);
+    perror("execv");
+    _exit(1);
+}
+
+static bool watch_directory(const String& path)
+{
+    if (s_watched_paths.contains(path))
+        return true;
+    int wd = inotify_add_watch(s_inotify_fd, path.characters(), s_watch_mask);
+    if (wd < 0)
+        return false;
+    s_watched_directories.set(wd, path);
+    s_watched_paths.set(path);
+    return true;
+}
+
+static bool is_meta_json(const char* name)
+{
+    size_t length = strlen(name);
+    return length >= 7 && !strcmp(name + length - 7, ".m.json");
+}
+
+static bool same_files(Vector<String> a, Vector<String> b)
+{
+    if (a.size() != b.size())
+        return false;
+    quick_sort(a.begin(), a.end(), [](auto& x, auto& y) { return x < y; });
+    quick_sort(b.begin(), b.end(), [](auto& x, auto& y) { return x < y; });
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i])
+            return false;
+    }
+    return true;
+}
+
+// Expands the globs that walked through the directory again. Returns false if one of
+// them found a different set of files, the model has to be reloaded then.
+static bool update_globs(const String& directory, Vector<String>& changed_directories)
+{
+    for (auto& key : GlobCache::the().keys_for_directory(directory)) {
+        Vector<DirectoryStamp> stamps;
+        auto files = FileProvider::the().expand_glob_key(key, stamps);
+        auto previous = GlobCache::the().files(key);
+        if (!previous.has_value() || !same_files(previous.value(), files))
+            return false;
+
+        // files created in a new directory before it was watched are found by expanding again
+        for (auto& stamp : stamps) {
+            if (!stamp.inode || s_watched_paths.contains(stamp.path))
+                continue;
+            if (!watch_directory(stamp.path))
+                return false;
+            if (!changed_directories.contains_slow(stamp.path))
+                changed_directories.append(stamp.path);
+        }
+        GlobCache::the().store(key, files, move(stamps));
+    }
+    return true;
+}
+
+// returns false if the model has to be reloaded
+static bool process_events(Function<bool(const String&)>& reload_meta_json_file)
+{
+    alignas(struct inotify_event) char buffer[16384];
+    Vector<String> changed_directories;
+    Vector<String> changed_meta_json_files;
+
+    for (;;) {
+        ssize_t nread = read(s_inotify_fd, buffer, sizeof(buffer));
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0 && errno == EAGAIN)
+            break;
+        if (nread <= 0) {
+            perror("read(inotify)");
+            return false;
+        }
+
+        for (char* position = buffer; position < buffer + nread;) {
+            auto* event = (struct inotify_event*)position;
+            position += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+                return false;
+            if (event->mask & IN_IGNORED) {
+                auto it = s_watched_directories.find(event->wd);
+                if (it != s_watched_directories.end()) {
+                    s_watched_paths.remove((*it).value);
+                    s_watched_directories.remove(it);
+                }
+                continue;
+            }
+            // the glob cache and the socket of the server itself
+            if (event->len && !strncmp(event->name, ".meta-", 6))
+                continue;
+            auto it = s_watched_directories.find(event->wd);
+            if (it == s_watched_directories.end())
+                continue;
+            auto& directory = (*it).value;
+
+            // created or removed meta json files change the result of their glob below
+            if (event->len && is_meta_json(event->name)) {
+                StringBuilder builder;
+                builder.appendf("%s/%s", directory.characters(), event->name);
+                auto filename = builder.build();
+                if (!changed_meta_json_files.contains_slow(filename))
+                    changed_meta_json_files.append(filename);
+            }
+            if (!(event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)))
+                continue;
+            if (!changed_directories.contains_slow(directory))
+                changed_directories.append(directory);
+        }
+    }
+
+    if (changed_directories.is_empty() && changed_meta_json_files.is_empty())
+        return true;
+
+    while (!changed_directories.is_empty()) {
+        if (!update_globs(changed_directories.take_first(), changed_directories))
+            return false;
+    }
+
+    for (auto& filename : changed_meta_json_files) {
+        fprintf(stderr, "meta serve: %s changed, loading it again\n", filename.characters());
+        if (!reload_meta_json_file(filename))
+            return false;
+    }
+    // the globs of the loaded packages
+    for (auto& directory : GlobCache::the().directories()) {
+        if (!watch_directory(directory))
+            return false;
+    }
+    GlobCache::the().save();
+    return true;
+}
+
+static bool modified_since(const String& path, const struct timespec& time)
+{
+    struct stat st;
+    if (stat(path.characters(), &st) < 0)
+        return true;
+    if (st.st_mtim.tv_sec != time.tv_sec)
+        return st.st_mtim.tv_sec > time.tv_sec;
+    return st.st_mtim.tv_nsec >= time.tv_nsec;
+}
+
+int serve(char** original_argv, const Vector<String>& meta_json_files, const struct timespec& load_start,
+    Function<int(int, char**)> execute, Function<bool(const String&)> reload_meta_json_file)
+{
+    auto path = socket_path();
+    if (path.is_empty()) {
+        fprintf(stderr, "meta serve needs a gendata directory.\n");
+        return 1;
+    }
+    create_dir(SettingsProvider::the().gendata_directory().value());
+
+    struct stat st;
+    if (stat(path.characters(), &st) == 0) {
+        auto probe = Core::LocalSocket::construct();
+        if (probe->connect(Core::SocketAddress::local(path))) {
+            fprintf(stderr, "A meta server is already running on %s\n", path.characters());
+            return 1;
+        }
+        unlink(path.characters());
+    }
+
+    s_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (s_inotify_fd < 0) {
+        perror("inotify_init1");
+        return 1;
+    }
+
+    Vector<String> directories = GlobCache::the().directories();
+    for (auto& file : meta_json_files)
+        directories.append(FileSystemPath(file).dirname());
+    FileProvider::the().for_each_parent_directory_including_current_dir([&](auto& directory) {
+        directories.append(directory);
+        return IterationDecision::Continue;
+    });
+
+    for (auto& directory : directories) {
+        if (watch_directory(directory))
+            continue;
+        if (errno == ENOENT || errno == ENOTDIR)
+            reload(original_argv);
+        fprintf(stderr, "Could not watch %s: %s\n", directory.characters(), strerror(errno));
+        if (errno == ENOSPC)
+            fprintf(stderr, "Raise fs.inotify.max_user_watches to serve this tree.\n");
+        return 1;
+    }
+
+    // changes made while loading happened before the watches existed, the gendata
+    // directory was just changed by saving the glob cache
+    auto gendata = SettingsProvider::the().gendata_directory().value();
+    for (auto& directory : directories) {
+        if (directory != gendata && modified_since(directory, load_start))
+            reload(original_argv);
+    }
+    for (auto& file : meta_json_files) {
+        if (modified_since(file, load_start))
+            reload(original_argv);
+    }
+
+    Core::EventLoop loop;
+    auto server = Core::LocalServer::construct();
+    if (!server->listen(path)) {
+        fprintf(stderr, "Could not listen on %s\n", path.characters());
+        return 1;
+    }
+    signal(SIGCHLD, SIG_IGN);
+
+    auto notifier = Core::Notifier::construct(s_inotify_fd, Core::Notifier::Event::Read);
+    notifier->on_ready_to_read = [&] {
+        if (!process_events(reload_meta_json_file))
+            reload(original_argv);
+    };
+
+    server->on_ready_to_accept = [&] {
+        auto client = server->accept();
+        if (!client)
+            return;
+
+        // changes made right before the command was started have to be seen by it
+        if (!process_events(reload_meta_json_file)) {
+            i32 not_served = s_not_served;
+            write_all(client->fd(), &not_served, sizeof(not_served));
+            reload(original_argv);
+        }
+
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return;
+        }
+        if (pid == 0)
+            _exit(run_request(client->fd(), execute));
+    };
+
+    fprintf(stderr, "meta serve: listening on %s\n", path.characters());
+    return loop.exec();
+}
+
+}
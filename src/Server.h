@@ -0,0 +1,27 @@
+#pragma once
+
+#include <AK/Function.h>
+#include <AK/Optional.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <time.h>
+
+// "meta serve" keeps the loaded model in memory and runs the commands of later meta
+// invocations in forked children, so they skip loading the meta json files. The client
+// passes its standard file descriptors, the children write to the terminal directly.
+// The directories the model was loaded from are watched with inotify: changed globs are
+// expanded again and changed meta json files that only define packages are loaded again
+// in place, other changes to the model reload the server. Commands run with the
+// environment of the client, unless it differs in a variable the model depends on.
+namespace Server {
+
+String socket_path();
+
+// does not return unless the server could not be started
+int serve(char** original_argv, const Vector<String>& meta_json_files, const struct timespec& load_start,
+    Function<int(int argc, char** argv)> execute, Function<bool(const String& filename)> reload_meta_json_file);
+
+// runs the command in a running server, returns its exit code if the server ran it
+Optional<int> forward(int argc, char** argv);
+
+}
@@ -29,6 +29,13 @@ bool Settings::load(const String& filename, const JsonObject& settings_object)
             } else
                 m_build_configuration = SettingsParameter { filename, value.as_object() };
 
+        } else if (key == "generator_configuration") {
+            if (m_generator_configuration.has_value()) {
+                failed = true;
+                return IterationDecision::Break;
+            } else
+                m_generator_configuration = SettingsParameter { filename, value.as_object() };
+
         } else if (key == "gendata_directory") {
             if (m_gendata_directory.has_value()) {
                 failed = true;
@@ -104,6 +111,8 @@ Optional<SettingsParameter> Settings::get(Badge<SettingsProvider>, const String
         return m_build_generator;
     } else if (parameter == "build_configuration") {
         return m_build_configuration;
+    } else if (parameter == "generator_configuration") {
+        return m_generator_configuration;
     } else if (parameter == "build_directory") {
         return m_build_directory;
     } else if (parameter == "gendata_directory") {
@@ -29,6 +29,7 @@ private:
     Optional<SettingsParameter> m_gendata_directory;
     Optional<SettingsParameter> m_build_generator;
     Optional<SettingsParameter> m_build_configuration;
+    Optional<SettingsParameter> m_generator_configuration;
 
     bool update_paths(const String& filename);
 };
@@ -33,9 +33,27 @@ bool SettingsProvider::add(const String& filename, SettingsPriority priority, co
         fprintf(stdout, "Error loading settings file: %s\n", filename.characters());
         return false;
     }
+
+    update_snapshot();
     return true;
 }
 
+void SettingsProvider::update_snapshot()
+{
+    m_snapshot.root = get_string("root");
+    m_snapshot.toolchain = get_string("toolchain");
+    m_snapshot.build_directory = get_string("build_directory");
+    m_snapshot.gendata_directory = get_string("gendata_directory");
+
+    auto build_configuration = get("build_configuration");
+    if (build_configuration.has_value() && build_configuration.value().is_json_object())
+        m_snapshot.build_configuration = build_configuration.value().as_json_object();
+
+    auto generator_configuration = get("generator_configuration");
+    if (generator_configuration.has_value() && generator_configuration.value().is_json_object())
+        m_snapshot.generator_configuration = generator_configuration.value().as_json_object();
+}
+
 Optional<SettingsParameter> SettingsProvider::get(const String& parameter)
 {
     for (auto& key : m_settings_sorted_keys) {
@@ -21,6 +21,16 @@ struct Traits<SettingsPriority> : public GenericTraits<SettingsPriority> {
 };
 }
 
+// flattened view of all settings, resolved by priority whenever settings are added
+struct SettingsSnapshot {
+    Optional<String> root;
+    Optional<String> toolchain;
+    Optional<String> build_directory;
+    Optional<String> gendata_directory;
+    JsonObject build_configuration;
+    JsonObject generator_configuration;
+};
+
 class SettingsProvider : public Core::Object {
     C_OBJECT(SettingsProvider)
 
@@ -32,11 +42,21 @@ public:
     Optional<SettingsParameter> get(const String& parameter);
     Optional<String> get_string(const String& parameter);
 
+    const Optional<String>& root() const { return m_snapshot.root; }
+    const Optional<String>& toolchain() const { return m_snapshot.toolchain; }
+    const Optional<String>& build_directory() const { return m_snapshot.build_directory; }
+    const Optional<String>& gendata_directory() const { return m_snapshot.gendata_directory; }
+    const JsonObject& build_configuration() const { return m_snapshot.build_configuration; }
+    const JsonObject& generator_configuration() const { return m_snapshot.generator_configuration; }
+
     void list_all();
 
 private:
     SettingsProvider();
 
+    void update_snapshot();
+
     HashMap<SettingsPriority, Settings*> m_settings;
     Vector<SettingsPriority> m_settings_sorted_keys;
+    SettingsSnapshot m_snapshot;
 };
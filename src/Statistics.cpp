@@ -0,0 +1,473 @@
+#include "Statistics.h"
+#include "GlobCache.h"
+#include "ImageDB.h"
+#include "PackageDB.h"
+#include "Profiler.h"
+#include "SettingsProvider.h"
+#include "ToolchainDB.h"
+#include <AK/HashMap.h>
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/QuickSort.h>
+#include <AK/StringBuilder.h>
+#include <LibCore/DirIterator.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+namespace Statistics {
+
+struct PackageMetrics {
+    const Package* package;
+    u32 source_files;
+    u64 source_bytes;
+    Vector<size_t> dependencies;
+    // packages the package depends on, directly or indirectly
+    u32 closure;
+    // packages on the longest dependency chain starting at the package, itself included
+    u32 depth;
+    // source files on the dependency chain with the most source files starting at the
+    // package, which have to be compiled one after another
+    u64 path_sources;
+    Optional<size_t> next_on_path;
+};
+
+struct Metrics {
+    u32 toolchains { 0 };
+    Vector<String> toolchain_names;
+    u32 target_tools { 0 };
+    u32 host_tools { 0 };
+    u32 build_tools { 0 };
+    u32 file_tool_mappings { 0 };
+
+    Vector<PackageMetrics> packages;
+    u32 include_directories { 0 };
+    u32 source_files { 0 };
+    u64 source_bytes { 0 };
+    u32 type_library { 0 };
+    u32 type_executable { 0 };
+    u32 type_collection { 0 };
+    u32 type_deployment { 0 };
+    u32 type_script { 0 };
+    u32 type_undefined { 0 };
+
+    Vector<String> image_names;
+
+    u32 dependency_edges { 0 };
+    u32 unresolved_dependencies { 0 };
+    u32 dependency_cycles { 0 };
+    u32 max_depth { 0 };
+    Vector<size_t> critical_path;
+    u64 critical_path_sources { 0 };
+
+    u32 generated_files { 0 };
+    u64 generated_bytes { 0 };
+};
+
+static String package_id(const Package& package)
+{
+    StringBuilder builder;
+    builder.append(package.machine_name());
+    builder.append("/");
+    builder.append(package.name());
+    return builder.build();
+}
+
+static void collect_packages(Metrics& metrics)
+{
+    HashMap<u32, size_t> index_of_package;
+    auto add_package = [&](auto&, auto& package) {
+        index_of_package.set(package.id(), metrics.packages.size());
+        metrics.packages.append({ &package, 0, 0, {}, 0, 0, 0, {} });
+        metrics.include_directories += package.includes().size();
+        switch (package.type()) {
+        case PackageType::Library:
+            ++metrics.type_library;
+            break;
+        case PackageType::Executable:
+            ++metrics.type_executable;
+            break;
+        case PackageType::Collection:
+            ++metrics.type_collection;
+            break;
+        case PackageType::Deployment:
+            ++metrics.type_deployment;
+            break;
+        case PackageType::Script:
+            ++metrics.type_script;
+            break;
+        case PackageType::Undefined:
+            ++metrics.type_undefined;
+            break;
+        }
+        return IterationDecision::Continue;
+    };
+    BuildPackageDB::the().for_each_entry(add_package);
+    HostPackageDB::the().for_each_entry(add_package);
+    TargetPackageDB::the().for_each_entry(add_package);
+
+    for (auto& metric : metrics.packages) {
+        for (auto source : metric.package->sources()) {
+            ++metric.source_files;
+            struct stat st;
+            if (stat(PathStore::the().path(source).characters(), &st) == 0)
+                metric.source_bytes += st.st_size;
+        }
+        metrics.source_files += metric.source_files;
+        metrics.source_bytes += metric.source_bytes;
+
+        for (auto& dependency : metric.package->dependencies()) {
+            auto* resolved = package_db_for_machine(metric.package->machine()).find_dependency(*metric.package, dependency.name);
+            auto it = resolved ? index_of_package.find(resolved->id()) : index_of_package.end();
+            if (it == index_of_package.end()) {
+                ++metrics.unresolved_dependencies;
+                continue;
+            }
+            if (!metric.dependencies.contains_slow((*it).value)) {
+                metric.dependencies.append((*it).value);
+                ++metrics.dependency_edges;
+            }
+        }
+    }
+}
+
+enum class VisitState : u8 {
+    New,
+    InProgress,
+    Done,
+};
+
+// longest and heaviest dependency chains, a dependency that closes a cycle is not followed
+static void measure_chains(Metrics& metrics, Vector<VisitState>& states, size_t index)
+{
+    auto& metric = metrics.packages[index];
+    states[index] = VisitState::InProgress;
+    u32 depth = 0;
+    u64 path_sources = 0;
+    for (auto dependency : metric.dependencies) {
+        if (states[dependency] == VisitState::InProgress) {
+            ++metrics.dependency_cycles;
+            continue;
+        }
+        if (states[dependency] == VisitState::New)
+            measure_chains(metrics, states, dependency);
+        auto& dependency_metric = metrics.packages[dependency];
+        if (dependency_metric.depth > depth)
+            depth = dependency_metric.depth;
+        if (!metric.next_on_path.has_value() || dependency_metric.path_sources > path_sources) {
+            path_sources = dependency_metric.path_sources;
+            metric.next_on_path = dependency;
+        }
+    }
+    metric.depth = depth + 1;
+    metric.path_sources = path_sources + metric.source_files;
+    states[index] = VisitState::Done;
+}
+
+static void measure_graph(Metrics& metrics)
+{
+    size_t count = metrics.packages.size();
+    Vector<VisitState> states;
+    for (size_t i = 0; i < count; ++i)
+        states.append(VisitState::New);
+    for (size_t i = 0; i < count; ++i) {
+        if (states[i] == VisitState::New)
+            measure_chains(metrics, states, i);
+    }
+
+    Optional<size_t> heaviest;
+    for (size_t i = 0; i < count; ++i) {
+        auto& metric = metrics.packages[i];
+        if (metric.depth > metrics.max_depth)
+            metrics.max_depth = metric.depth;
+        if (!heaviest.has_value() || metric.path_sources > metrics.packages[heaviest.value()].path_sources)
+            heaviest = i;
+    }
+    for (auto index = heaviest; index.has_value(); index = metrics.packages[index.value()].next_on_path) {
+        metrics.critical_path.append(index.value());
+        metrics.critical_path_sources += metrics.packages[index.value()].source_files;
+    }
+
+    // transitive closures, the visit marks are the number of the walk to avoid clearing them
+    Vector<u32> visited;
+    for (size_t i = 0; i < count; ++i)
+        visited.append(0);
+    Vector<size_t> stack;
+    for (size_t i = 0; i < count; ++i) {
+        u32 walk = i + 1;
+        u32 closure = 0;
+        visited[i] = walk;
+        stack.append(i);
+        while (!stack.is_empty()) {
+            for (auto dependency : metrics.packages[stack.take_last()].dependencies) {
+                if (visited[dependency] == walk)
+                    continue;
+                visited[dependency] = walk;
+                ++closure;
+                stack.append(dependency);
+            }
+        }
+        metrics.packages[i].closure = closure;
+    }
+}
+
+static void count_files(const String& directory, Metrics& metrics)
+{
+    Core::DirIterator di(directory, Core::DirIterator::SkipDots);
+    if (di.has_error())
+        return;
+    while (di.has_next()) {
+        StringBuilder builder;
+        builder.append(directory);
+        builder.append("/");
+        builder.append(di.next_path());
+        auto path = builder.build();
+
+        struct stat st;
+        if (lstat(path.characters(), &st) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode)) {
+            count_files(path, metrics);
+        } else if (S_ISREG(st.st_mode)) {
+            ++metrics.generated_files;
+            metrics.generated_bytes += st.st_size;
+        }
+    }
+}
+
+// indices of the packages with the largest value, largest first
+template<typename Value>
+static Vector<size_t> top_packages(const Metrics& metrics, size_t count, Value value)
+{
+    Vector<size_t> indices;
+    for (size_t i = 0; i < metrics.packages.size(); ++i)
+        indices.append(i);
+    quick_sort(indices.begin(), indices.end(), [&](auto& a, auto& b) {
+        return value(metrics.packages[a]) > value(metrics.packages[b]);
+    });
+    Vector<size_t> top;
+    for (size_t i = 0; i < indices.size() && i < count; ++i)
+        top.append(indices[i]);
+    return top;
+}
+
+static u64 closure_of(const PackageMetrics& metric)
+{
+    return metric.closure;
+}
+
+static u64 source_bytes_of(const PackageMetrics& metric)
+{
+    return metric.source_bytes;
+}
+
+static void print_list(const Vector<String>& names)
+{
+    StringBuilder builder;
+    for (auto& name : names) {
+        builder.append(name);
+        builder.append(", ");
+    }
+    fprintf(stdout, "* %s\033[2D \n", builder.build().characters());
+}
+
+static void print_text(const Metrics& metrics)
+{
+    Vector<String> package_names;
+    for (auto& metric : metrics.packages)
+        package_names.append(metric.package->name());
+
+    fprintf(stdout, "----- STATISTICS -----\n");
+    fprintf(stdout, "Toolchains: %u\n", metrics.toolchains);
+    if (metrics.toolchains)
+        print_list(metrics.toolchain_names);
+    fprintf(stdout, "Build tools: %u\n", metrics.build_tools);
+    fprintf(stdout, "Host tools: %u\n", metrics.host_tools);
+    fprintf(stdout, "Target tools: %u\n", metrics.target_tools);
+    fprintf(stdout, "File extension tool mappings: %u\n", metrics.file_tool_mappings);
+    fprintf(stdout, "----- ---------- -----\n");
+    fprintf(stdout, "Packages: %u\n", (u32)metrics.packages.size());
+    if (metrics.packages.size())
+        print_list(package_names);
+    fprintf(stdout, "Packages with type Library: %u\n", metrics.type_library);
+    fprintf(stdout, "Packages with type Executable: %u\n", metrics.type_executable);
+    fprintf(stdout, "Packages with type Collection: %u\n", metrics.type_collection);
+    fprintf(stdout, "Packages with type Deployment: %u\n", metrics.type_deployment);
+    fprintf(stdout, "Packages with type Script: %u\n", metrics.type_script);
+    fprintf(stdout, "Packages with undefined type: %u\n", metrics.type_undefined);
+    fprintf(stdout, "Number of source files: %u\n", metrics.source_files);
+    fprintf(stdout, "Size of source files: %llu KiB\n", (unsigned long long)metrics.source_bytes / 1024);
+    fprintf(stdout, "Number of include directories: %u\n", metrics.include_directories);
+    fprintf(stdout, "Largest packages by source size:\n");
+    for (auto index : top_packages(metrics, 5, source_bytes_of)) {
+        auto& metric = metrics.packages[index];
+        fprintf(stdout, "* %s: %u files, %llu KiB\n", package_id(*metric.package).characters(), metric.source_files,
+            (unsigned long long)metric.source_bytes / 1024);
+    }
+    fprintf(stdout, "----- ---------- -----\n");
+    fprintf(stdout, "Dependency edges: %u\n", metrics.dependency_edges);
+    fprintf(stdout, "Unresolved dependencies: %u\n", metrics.unresolved_dependencies);
+    fprintf(stdout, "Dependency cycles: %u\n", metrics.dependency_cycles);
+    fprintf(stdout, "Longest dependency chain: %u packages\n", metrics.max_depth);
+    fprintf(stdout, "Critical path: %u source files\n", (u32)metrics.critical_path_sources);
+    for (auto index : metrics.critical_path) {
+        auto& metric = metrics.packages[index];
+        fprintf(stdout, "* %s (%u source files)\n", package_id(*metric.package).characters(), metric.source_files);
+    }
+    fprintf(stdout, "Largest transitive dependency closures:\n");
+    for (auto index : top_packages(metrics, 5, closure_of)) {
+        auto& metric = metrics.packages[index];
+        fprintf(stdout, "* %s: %u packages\n", package_id(*metric.package).characters(), metric.closure);
+    }
+    fprintf(stdout, "----- ---------- -----\n");
+    fprintf(stdout, "Images: %u\n", (u32)metrics.image_names.size());
+    if (metrics.image_names.size())
+        print_list(metrics.image_names);
+    fprintf(stdout, "----- ---------- -----\n");
+    fprintf(stdout, "Glob cache hits: %u\n", GlobCache::the().hits());
+    fprintf(stdout, "Glob cache misses: %u\n", GlobCache::the().misses());
+    fprintf(stdout, "Directories scanned by globs: %u\n", GlobCache::the().directories_scanned());
+    fprintf(stdout, "Generated files: %u (%llu KiB)\n", metrics.generated_files, (unsigned long long)metrics.generated_bytes / 1024);
+    auto phases = Profiler::the().phase_totals();
+    if (phases.size()) {
+        fprintf(stdout, "----- ---------- -----\n");
+        fprintf(stdout, "Phases:\n");
+        for (auto& phase : phases)
+            fprintf(stdout, "* %s: %.1f ms (%u calls)\n", phase.name.characters(), phase.total_us / 1000.0, phase.calls);
+    }
+    fprintf(stdout, "----------------------\n");
+}
+
+static JsonArray json_names(const Vector<String>& names)
+{
+    JsonArray array;
+    for (auto& name : names)
+        array.append(name);
+    return array;
+}
+
+static void print_json(const Metrics& metrics)
+{
+    JsonObject toolchains;
+    toolchains.set("count", metrics.toolchains);
+    toolchains.set("names", json_names(metrics.toolchain_names));
+    toolchains.set("build_tools", metrics.build_tools);
+    toolchains.set("host_tools", metrics.host_tools);
+    toolchains.set("target_tools", metrics.target_tools);
+    toolchains.set("file_tool_mappings", metrics.file_tool_mappings);
+
+    JsonObject types;
+    types.set("library", metrics.type_library);
+    types.set("executable", metrics.type_executable);
+    types.set("collection", metrics.type_collection);
+    types.set("deployment", metrics.type_deployment);
+    types.set("script", metrics.type_script);
+    types.set("undefined", metrics.type_undefined);
+
+    JsonArray package_list;
+    for (auto& metric : metrics.packages) {
+        JsonObject package;
+        package.set("name", metric.package->name());
+        package.set("machine", metric.package->machine_name());
+        package.set("source_files", metric.source_files);
+        package.set("source_bytes", metric.source_bytes);
+        package.set("include_directories", (u32)metric.package->includes().size());
+        package.set("direct_dependencies", (u32)metric.dependencies.size());
+        package.set("transitive_dependencies", metric.closure);
+        package.set("depth", metric.depth);
+        package_list.append(package);
+    }
+
+    JsonObject packages;
+    packages.set("count", (u32)metrics.packages.size());
+    packages.set("types", types);
+    packages.set("source_files", metrics.source_files);
+    packages.set("source_bytes", metrics.source_bytes);
+    packages.set("include_directories", metrics.include_directories);
+    packages.set("packages", package_list);
+
+    JsonArray critical_path;
+    for (auto index : metrics.critical_path)
+        critical_path.append(package_id(*metrics.packages[index].package));
+
+    JsonArray largest_closures;
+    for (auto index : top_packages(metrics, 10, closure_of)) {
+        JsonObject closure;
+        closure.set("package", package_id(*metrics.packages[index].package));
+        closure.set("transitive_dependencies", metrics.packages[index].closure);
+        largest_closures.append(closure);
+    }
+
+    JsonObject graph;
+    graph.set("dependency_edges", metrics.dependency_edges);
+    graph.set("unresolved_dependencies", metrics.unresolved_dependencies);
+    graph.set("cycles", metrics.dependency_cycles);
+    graph.set("max_depth", metrics.max_depth);
+    graph.set("critical_path", critical_path);
+    graph.set("critical_path_source_files", metrics.critical_path_sources);
+    graph.set("largest_closures", largest_closures);
+
+    JsonObject io;
+    io.set("glob_cache_hits", GlobCache::the().hits());
+    io.set("glob_cache_misses", GlobCache::the().misses());
+    io.set("glob_directories_scanned", GlobCache::the().directories_scanned());
+    io.set("generated_files", metrics.generated_files);
+    io.set("generated_bytes", metrics.generated_bytes);
+
+    JsonArray phases;
+    for (auto& phase_total : Profiler::the().phase_totals()) {
+        JsonObject phase;
+        phase.set("name", phase_total.name);
+        phase.set("calls", phase_total.calls);
+        phase.set("total_us", phase_total.total_us);
+        phase.set("self_us", phase_total.self_us);
+        phase.set("max_us", phase_total.max_us);
+        phases.append(phase);
+    }
+
+    JsonObject images;
+    images.set("count", (u32)metrics.image_names.size());
+    images.set("names", json_names(metrics.image_names));
+
+    JsonObject statistics;
+    statistics.set("toolchains", toolchains);
+    statistics.set("packages", packages);
+    statistics.set("images", images);
+    statistics.set("graph", graph);
+    statistics.set("io", io);
+    statistics.set("phases", phases);
+    fprintf(stdout, "%s\n", statistics.to_string().characters());
+}
+
+void print(bool as_json)
+{
+    Metrics metrics;
+
+    ToolchainDB::the().for_each_entry([&](auto& name, auto& toolchain) {
+        ++metrics.toolchains;
+        metrics.toolchain_names.append(name);
+        metrics.target_tools += toolchain.target_tools().size();
+        metrics.host_tools += toolchain.host_tools().size();
+        metrics.build_tools += toolchain.build_tools().size();
+        metrics.file_tool_mappings += toolchain.file_tool_mapping().size();
+        return IterationDecision::Continue;
+    });
+
+    collect_packages(metrics);
+    measure_graph(metrics);
+
+    ImageDB::the().for_each_entry([&](auto& name, auto&) {
+        metrics.image_names.append(name);
+        return IterationDecision::Continue;
+    });
+
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
+    if (!gen_path.is_empty())
+        count_files(gen_path, metrics);
+
+    if (as_json)
+        print_json(metrics);
+    else
+        print_text(metrics);
+}
+
+}
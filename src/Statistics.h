@@ -0,0 +1,10 @@
+#pragma once
+
+// "meta stats": the size of the loaded model, the shape of the dependency graph, the
+// file system work of the run and the time spent in its phases.
+namespace Statistics {
+
+// human readable on stdout, or a single JSON object for dashboards
+void print(bool as_json);
+
+}
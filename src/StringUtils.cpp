@@ -1,6 +1,7 @@
 #include "StringUtils.h"
+#include <AK/Optional.h>
 #include <AK/StringBuilder.h>
-#include <regex>
+#include <string.h>
 
 bool potentially_contains_variable(const String& haystack)
 {
@@ -12,18 +13,113 @@ bool potentially_contains_variable(const String& haystack)
     return false;
 }
 
+struct VariableMatch {
+    size_t start;
+    size_t end;
+    const String* value;
+};
+
+// finds the next ${name} at or after offset, for which lookup knows a value
+template<typename Lookup>
+static bool next_variable(const StringView& haystack, size_t offset, Lookup lookup, VariableMatch& match)
+{
+    for (size_t i = offset; i + 2 < haystack.length(); ++i) {
+        if (haystack.characters_without_null_termination()[i] != '$' || haystack.characters_without_null_termination()[i + 1] != '{')
+            continue;
+
+        size_t name_end = i + 2;
+        while (name_end < haystack.length() && haystack.characters_without_null_termination()[name_end] != '}')
+            ++name_end;
+        if (name_end == haystack.length())
+            return false;
+
+        auto* value = lookup(haystack.substring_view(i + 2, name_end - i - 2));
+        if (value) {
+            match = { i, name_end + 1, value };
+            return true;
+        }
+    }
+    return false;
+}
+
+// single scan over the haystack, the result is only built if a known variable is found
+template<typename Lookup>
+static String expand(const String& haystack, Lookup lookup)
+{
+    StringView view(haystack);
+    VariableMatch match;
+    if (!next_variable(view, 0, lookup, match))
+        return haystack;
+
+    StringBuilder builder;
+    size_t offset = 0;
+    do {
+        builder.append(view.substring_view(offset, match.start - offset));
+        builder.append(*match.value);
+        offset = match.end;
+    } while (next_variable(view, offset, lookup, match));
+    builder.append(view.substring_view(offset, view.length() - offset));
+
+    return builder.build();
+}
+
+String expand_variables(const String& haystack, const HashMap<String, String>& variables)
+{
+    return expand(haystack, [&](const StringView& name) -> const String* {
+        for (auto& variable : variables) {
+            if (name == StringView(variable.key))
+                return &variable.value;
+        }
+        return nullptr;
+    });
+}
+
 String replace_variables(const String& haystack, const String& varname, const String& replacement)
 {
-    StringBuilder sb;
-    sb.append("\\$\\{");
-    sb.append(varname);
-    sb.append("\\}");
-    return replace(haystack, sb.build(), replacement);
+    return expand(haystack, [&](const StringView& name) -> const String* {
+        if (name == StringView(varname))
+            return &replacement;
+        return nullptr;
+    });
+}
+
+static Optional<size_t> find(const String& haystack, const String& needle, size_t offset)
+{
+    for (size_t i = offset; i + needle.length() <= haystack.length(); ++i) {
+        if (!memcmp(haystack.characters() + i, needle.characters(), needle.length()))
+            return i;
+    }
+    return {};
 }
 
 String replace(const String& haystack, const String& needle, const String& replacement)
 {
-    std::string hs(haystack.characters(), haystack.length());
-    std::string replaced = std::regex_replace(hs, std::regex(needle.characters()), replacement.characters());
-    return replaced.c_str();
+    if (needle.is_empty())
+        return haystack;
+
+    auto position = find(haystack, needle, 0);
+    if (!position.has_value())
+        return haystack;
+
+    StringBuilder builder;
+    size_t offset = 0;
+    do {
+        builder.append(haystack.substring_view(offset, position.value() - offset));
+        builder.append(replacement);
+        offset = position.value() + needle.length();
+        position = find(haystack, needle, offset);
+    } while (position.has_value());
+    builder.append(haystack.substring_view(offset, haystack.length() - offset));
+
+    return builder.build();
+}
+
+u64 fnv1a_hash(const StringView& data, u64 hash)
+{
+    auto* characters = data.characters_without_null_termination();
+    for (size_t i = 0; i < data.length(); ++i) {
+        hash ^= (u8)characters[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <AK/HashMap.h>
 #include <AK/String.h>
 
 bool potentially_contains_variable(const String& haystack);
+String expand_variables(const String& haystack, const HashMap<String, String>& variables);
 String replace_variables(const String& haystack, const String& varname, const String& replacement);
 String replace(const String& haystack, const String& needle, const String& replacement);
+
+// 64 bit FNV-1a, continue a hash by passing the previous result
+u64 fnv1a_hash(const StringView& data, u64 hash = 14695981039346656037ULL);
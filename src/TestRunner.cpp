@@ -0,0 +1,304 @@
+#include "TestRunner.h"
+#include "PackageDB.h"
+#include "Profiler.h"
+#include "StringUtils.h"
+#include <AK/QuickSort.h>
+#include <AK/StringBuilder.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static u64 now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static String durations_filename(const String& build_directory)
+{
+    StringBuilder builder;
+    builder.append(build_directory);
+    builder.append("/.meta-test-durations");
+    return builder.build();
+}
+
+TestRunner::TestRunner(const String& build_directory, u32 jobs, u32 timeout_seconds)
+    : m_build_directory(build_directory)
+    , m_jobs(jobs ? jobs : 1)
+    , m_timeout_ms(timeout_seconds * 1000)
+{
+}
+
+void TestRunner::set_shard(u32 index, u32 count)
+{
+    m_shard_index = index;
+    m_shard_count = count;
+}
+
+void TestRunner::collect_tests()
+{
+    // the host toolchain adds every host package as subdirectory with its name, and every
+    // test executable as Tests/<test> below it, see gen_toolchain and gen_test_executable
+    HostPackageDB::the().for_each_entry([&](auto&, auto& package) {
+        if (package.test().is_null())
+            return IterationDecision::Continue;
+        for (auto& test_executable : package.test()->executables()) {
+            StringBuilder name;
+            name.appendf("%s_%s", package.name().characters(), test_executable.name().characters());
+            auto test_name = name.build();
+            if (fnv1a_hash(test_name) % m_shard_count != m_shard_index - 1)
+                continue;
+
+            StringBuilder directory;
+            directory.appendf("%s/HostToolchain/%s/Tests/%s", m_build_directory.characters(), package.name().characters(),
+                test_executable.name().characters());
+            auto test_directory = directory.build();
+
+            StringBuilder executable;
+            executable.appendf("%s/%s", test_directory.characters(), test_name.characters());
+
+            // unknown tests first, they might be the longest
+            auto it = m_durations.find(test_name);
+            u64 expected_ms = it != m_durations.end() ? (*it).value : UINT64_MAX;
+            m_tests.append({ test_name, executable.build(), test_directory, expected_ms });
+        }
+        return IterationDecision::Continue;
+    });
+
+    quick_sort(m_tests.begin(), m_tests.end(), [](auto& a, auto& b) {
+        if (a.expected_ms != b.expected_ms)
+            return a.expected_ms > b.expected_ms;
+        return a.name < b.name;
+    });
+}
+
+bool TestRunner::start(const TestCase& test)
+{
+    if (access(test.executable.characters(), X_OK) < 0) {
+        report(test, Result::NotBuilt, 0, {});
+        return false;
+    }
+
+    int output_pipe[2];
+    if (pipe2(output_pipe, O_CLOEXEC) < 0) {
+        perror("pipe");
+        report(test, Result::Failed, 0, {});
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        report(test, Result::Failed, 0, {});
+        return false;
+    }
+
+    if (pid == 0) {
+        // own process group, so a timeout also kills the processes the test started
+        setpgid(0, 0);
+        // resources of the test are linked into its binary directory
+        if (chdir(test.directory.characters()) < 0) {
+            perror("chdir");
+            _exit(127);
+        }
+        dup2(output_pipe[1], STDOUT_FILENO);
+        dup2(output_pipe[1], STDERR_FILENO);
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0)
+            dup2(null_fd, STDIN_FILENO);
+        execl(test.executable.characters(), test.executable.characters(), nullptr);
+        perror("execl");
+        _exit(127);
+    }
+
+    // set by both, whichever runs first, so the group exists before a kill can target it
+    setpgid(pid, pid);
+    close(output_pipe[1]);
+    m_running.append({ &test, pid, output_pipe[0], now_ms(), false, {} });
+    return true;
+}
+
+void TestRunner::finish(RunningTest& running, int status)
+{
+    u64 duration_ms = now_ms() - running.start_ms;
+    Result result = Result::Passed;
+    if (running.timed_out)
+        result = Result::TimedOut;
+    else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        result = Result::Failed;
+
+    if (result != Result::TimedOut)
+        m_durations.set(running.test->name, duration_ms);
+    report(*running.test, result, duration_ms, running.output);
+}
+
+void TestRunner::report(const TestCase& test, Result result, u64 duration_ms, const Vector<char>& output)
+{
+    const char* label = "PASS";
+    switch (result) {
+    case Result::Passed:
+        break;
+    case Result::Failed:
+        label = "FAIL";
+        break;
+    case Result::TimedOut:
+        label = "TIMEOUT";
+        break;
+    case Result::NotBuilt:
+        label = "NOT BUILT";
+        break;
+    }
+    ++m_finished;
+    if (result != Result::Passed)
+        ++m_failed;
+
+    fprintf(stdout, "[%3u/%3u] %-9s %s (%.2f s)\n", m_finished, (u32)m_tests.size(), label, test.name.characters(),
+        duration_ms / 1000.0);
+    if (result == Result::Failed || result == Result::TimedOut) {
+        fwrite(output.data(), 1, output.size(), stdout);
+        if (output.size() && output[output.size() - 1] != '\n')
+            fputc('\n', stdout);
+    }
+    if (result == Result::NotBuilt)
+        fprintf(stdout, "%s does not exist, is the package built?\n", test.executable.characters());
+    fflush(stdout);
+}
+
+bool TestRunner::run()
+{
+    ProfileScope scope("run tests");
+    load_durations();
+    collect_tests();
+    if (m_shard_count > 1)
+        fprintf(stdout, "Shard %u of %u: ", m_shard_index, m_shard_count);
+    fprintf(stdout, "Running %u tests with %u jobs.\n", (u32)m_tests.size(), m_jobs);
+    fflush(stdout);
+
+    u64 start_ms = now_ms();
+    size_t next_test = 0;
+    while (next_test < m_tests.size() || !m_running.is_empty()) {
+        while (next_test < m_tests.size() && m_running.size() < m_jobs)
+            start(m_tests[next_test++]);
+        if (m_running.is_empty())
+            continue;
+
+        // sleep until a test writes output, closes it by exiting or reaches its timeout
+        int timeout = -1;
+        Vector<struct pollfd> fds;
+        for (auto& running : m_running) {
+            if (m_timeout_ms) {
+                u64 elapsed_ms = now_ms() - running.start_ms;
+                int remaining = elapsed_ms >= m_timeout_ms ? 0 : (int)(m_timeout_ms - elapsed_ms);
+                if (timeout < 0 || remaining < timeout)
+                    timeout = remaining;
+            }
+            // a test that closed its output is waited for below, poll only until it exits
+            if (running.fd < 0)
+                timeout = (timeout < 0 || timeout > 10) ? 10 : timeout;
+            fds.append({ running.fd, POLLIN, 0 });
+        }
+
+        int rc = poll(fds.data(), fds.size(), timeout);
+        if (rc < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+
+        for (size_t i = 0; rc > 0 && i < fds.size(); ++i) {
+            auto& running = m_running[i];
+            if (!fds[i].revents || running.fd < 0)
+                continue;
+            char buffer[4096];
+            ssize_t nread = read(running.fd, buffer, sizeof(buffer));
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread <= 0) {
+                close(running.fd);
+                running.fd = -1;
+                continue;
+            }
+            for (ssize_t j = 0; j < nread; ++j)
+                running.output.append(buffer[j]);
+        }
+
+        for (size_t i = 0; i < m_running.size();) {
+            auto& running = m_running[i];
+            if (m_timeout_ms && !running.timed_out && now_ms() - running.start_ms >= m_timeout_ms) {
+                kill(-running.pid, SIGKILL);
+                running.timed_out = true;
+            }
+
+            int status = 0;
+            pid_t pid = waitpid(running.pid, &status, running.timed_out ? 0 : WNOHANG);
+            if (pid == 0 || (pid < 0 && errno == EINTR)) {
+                ++i;
+                continue;
+            }
+            if (running.fd >= 0) {
+                // the rest of the output, unless a child of the test still holds the pipe open
+                fcntl(running.fd, F_SETFL, O_NONBLOCK);
+                char buffer[4096];
+                ssize_t nread;
+                while ((nread = read(running.fd, buffer, sizeof(buffer))) > 0) {
+                    for (ssize_t j = 0; j < nread; ++j)
+                        running.output.append(buffer[j]);
+                }
+                close(running.fd);
+            }
+            finish(running, status);
+            m_running.remove(i);
+        }
+    }
+
+    save_durations();
+    fprintf(stdout, "%u of %u tests passed in %.2f s.\n", (u32)m_tests.size() - m_failed, (u32)m_tests.size(),
+        (now_ms() - start_ms) / 1000.0);
+    return m_failed == 0;
+}
+
+void TestRunner::load_durations()
+{
+    FILE* fd = fopen(durations_filename(m_build_directory).characters(), "r");
+    if (!fd)
+        return;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fd)) {
+        char* name = nullptr;
+        u64 duration_ms = strtoull(line, &name, 10);
+        if (name == line || *name != ' ')
+            continue;
+        ++name;
+        size_t length = strlen(name);
+        if (length && name[length - 1] == '\n')
+            --length;
+        if (length)
+            m_durations.set(String(name, length), duration_ms);
+    }
+    fclose(fd);
+}
+
+// "<milliseconds> <test>" per line, tests that did not run in this shard keep their entries
+void TestRunner::save_durations() const
+{
+    auto filename = durations_filename(m_build_directory);
+    FILE* fd = fopen(filename.characters(), "w");
+    if (!fd) {
+        fprintf(stderr, "Could not write test durations %s: %s\n", filename.characters(), strerror(errno));
+        return;
+    }
+    for (auto& it : m_durations)
+        fprintf(fd, "%llu %s\n", (unsigned long long)it.value, it.key.characters());
+    fclose(fd);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+
+// Runs the test executables of the host packages in parallel. Every test gets a
+// timeout, and its output is only shown if it fails. The durations of the tests are
+// kept in .meta-test-durations in the build directory, the tests that took longest
+// last time are started first so that they don't end up running alone at the end.
+class TestRunner {
+public:
+    TestRunner(const String& build_directory, u32 jobs, u32 timeout_seconds);
+
+    // runs every count-th test of the 1-based shard index, the assignment only depends
+    // on the test names, so all machines agree on it
+    void set_shard(u32 index, u32 count);
+
+    // returns false if a test failed, timed out or was not built
+    bool run();
+
+private:
+    enum class Result : u8 {
+        Passed,
+        Failed,
+        TimedOut,
+        NotBuilt,
+    };
+
+    struct TestCase {
+        String name;
+        String executable;
+        String directory;
+        u64 expected_ms;
+    };
+
+    struct RunningTest {
+        const TestCase* test;
+        int pid;
+        int fd;
+        u64 start_ms;
+        bool timed_out;
+        Vector<char> output;
+    };
+
+    void collect_tests();
+    bool start(const TestCase&);
+    void finish(RunningTest&, int status);
+    void report(const TestCase&, Result, u64 duration_ms, const Vector<char>& output);
+    void load_durations();
+    void save_durations() const;
+
+    String m_build_directory;
+    u32 m_jobs;
+    u32 m_timeout_ms;
+    u32 m_shard_index { 1 };
+    u32 m_shard_count { 1 };
+
+    Vector<TestCase> m_tests;
+    Vector<RunningTest> m_running;
+    HashMap<String, u64> m_durations;
+    u32 m_finished { 0 };
+    u32 m_failed { 0 };
+};
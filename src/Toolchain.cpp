@@ -1,9 +1,11 @@
 #include "Toolchain.h"
+#include "BinaryFile.h"
+#include "FileProvider.h"
 #include "SettingsProvider.h"
 #include "StringUtils.h"
 #include <AK/FileSystemPath.h>
 
-Toolchain::Toolchain(const String& name, const String& filename, JsonObject json_obj)
+Toolchain::Toolchain(const String& name, const String& filename, const JsonObject& json_obj)
     : m_name(name)
     , m_filename(filename)
 {
@@ -25,15 +27,15 @@ Toolchain::Toolchain(const String& name, const String& filename, JsonObject json
                     value.as_object().for_each_member([&](auto& key, auto& value) {
                         if (key == "flags") {
                             if (value.is_string()) {
-                                tool_configuration.flags = replace_variables(value.as_string(), "root", SettingsProvider::the().get_string("root").value_or(""));
+                                tool_configuration.flags = replace_variables(value.as_string(), "root", SettingsProvider::the().root().value_or(""));
                             } else if (value.is_array()) {
                             } else if (value.is_array()) {
-                                auto values = value.as_array().values();
+                                auto& values = value.as_array().values();
                                 StringBuilder builder;
                                 builder.append(tool_configuration.flags);
                                 for (auto& value : values) {
                                     builder.append(" ");
-                                    builder.append(replace_variables(value.as_string(), "root", SettingsProvider::the().get_string("root").value_or("")));
+                                    builder.append(replace_variables(value.as_string(), "root", SettingsProvider::the().root().value_or("")));
                                 }
                                 tool_configuration.flags = builder.build();
                             }
@@ -49,6 +51,14 @@ Toolchain::Toolchain(const String& name, const String& filename, JsonObject json
 
             return;
         }
+        if (key == "launcher") {
+            auto launcher = parse_launcher(value, filename);
+            if (launcher.executable.is_empty())
+                fprintf(stderr, "No executable given for launcher of toolchain %s\n", m_name.characters());
+            else
+                m_launcher = launcher;
+            return;
+        }
         if (key == "target_tools") {
             insert_tool(m_target_tools, value.as_object(), filename);
             return;
@@ -65,10 +75,137 @@ Toolchain::Toolchain(const String& name, const String& filename, JsonObject json
     });
 }
 
+Toolchain::Toolchain(const String& name, BinaryReader& reader)
+    : m_name(name)
+{
+    m_filename = reader.read_string();
+    m_file_tool_mapping = reader.read_string_map();
+    u32 configuration_count = reader.read_value<u32>();
+    for (u32 i = 0; i < configuration_count && !reader.has_error(); ++i) {
+        auto config_name = reader.read_string();
+        HashMap<String, ToolConfiguration> tool_configurations;
+        auto flags = reader.read_string_map();
+        for (auto& it : flags)
+            tool_configurations.set(it.key, { it.value });
+        m_configuration.set(config_name, tool_configurations);
+    }
+    m_target_tools = read_tools(reader);
+    m_build_tools = read_tools(reader);
+    m_host_tools = read_tools(reader);
+    if (reader.read_value<bool>())
+        m_launcher = read_launcher(reader);
+}
+
 Toolchain::~Toolchain()
 {
 }
 
+void Toolchain::write(BinaryWriter& writer) const
+{
+    writer.write_string(m_filename);
+    writer.write_string_map(m_file_tool_mapping);
+    writer.write_value((u32)m_configuration.size());
+    for (auto& configuration : m_configuration) {
+        writer.write_string(configuration.key);
+        HashMap<String, String> flags;
+        for (auto& tool_configuration : configuration.value)
+            flags.set(tool_configuration.key, tool_configuration.value.flags);
+        writer.write_string_map(flags);
+    }
+    write_tools(writer, m_target_tools);
+    write_tools(writer, m_build_tools);
+    write_tools(writer, m_host_tools);
+    writer.write_value(m_launcher.has_value());
+    if (m_launcher.has_value())
+        write_launcher(writer, m_launcher.value());
+}
+
+void Toolchain::write_launcher(BinaryWriter& writer, const Launcher& launcher)
+{
+    writer.write_string(launcher.executable);
+    writer.write_string_map(launcher.environment);
+}
+
+Launcher Toolchain::read_launcher(BinaryReader& reader)
+{
+    Launcher launcher;
+    launcher.executable = reader.read_string();
+    launcher.environment = reader.read_string_map();
+    return launcher;
+}
+
+void Toolchain::write_tools(BinaryWriter& writer, const HashMap<String, Tool>& tools)
+{
+    writer.write_value((u32)tools.size());
+    for (auto& it : tools) {
+        auto& tool = it.value;
+        writer.write_string(it.key);
+        writer.write_string(tool.executable);
+        writer.write_string(tool.flags);
+        writer.write_string(tool.test_flags);
+        writer.write_value(tool.run_as_su);
+        writer.write_value(tool.add_as_target);
+        writer.write_value(tool.reset_toolchain_flags);
+        writer.write_string_map(tool.execution_result_definitions);
+        writer.write_value(tool.launcher.has_value());
+        if (tool.launcher.has_value())
+            write_launcher(writer, tool.launcher.value());
+    }
+}
+
+HashMap<String, Tool> Toolchain::read_tools(BinaryReader& reader)
+{
+    HashMap<String, Tool> tools;
+    u32 count = reader.read_value<u32>();
+    for (u32 i = 0; i < count && !reader.has_error(); ++i) {
+        auto name = reader.read_string();
+        Tool tool;
+        tool.executable = reader.read_string();
+        tool.flags = reader.read_string();
+        tool.test_flags = reader.read_string();
+        tool.run_as_su = reader.read_value<bool>();
+        tool.add_as_target = reader.read_value<bool>();
+        tool.reset_toolchain_flags = reader.read_value<bool>();
+        tool.execution_result_definitions = reader.read_string_map();
+        if (reader.read_value<bool>())
+            tool.launcher = read_launcher(reader);
+        tools.set(name, tool);
+    }
+    return tools;
+}
+
+// "launcher": "ccache" | { "executable": "ccache", "environment": { "CCACHE_MAXSIZE": "5G" }, "path_environment": { "CCACHE_DIR": "${root}/../ccache" } }
+// The values of "path_environment" are paths relative to the directory of the toolchain file, the
+// ones of "environment" are passed as they are.
+Launcher Toolchain::parse_launcher(const JsonValue& value, const String& filename)
+{
+    Launcher launcher;
+    if (value.is_string()) {
+        launcher.executable = value.as_string();
+        return launcher;
+    }
+    if (!value.is_object())
+        return launcher;
+
+    auto directory = FileSystemPath(filename).dirname();
+    launcher.executable = value.as_object().get("executable").as_string_or("");
+    auto add_environment = [&](const char* key, bool is_path) {
+        auto environment = value.as_object().get(key);
+        if (!environment.is_object())
+            return;
+        environment.as_object().for_each_member([&](auto& name, auto& value) {
+            auto str = replace_variables(value.as_string(), "root", SettingsProvider::the().root().value_or(""));
+            str = replace_variables(str, "current_dir", directory);
+            if (is_path)
+                str = FileProvider::the().make_absolute_path(str, directory);
+            launcher.environment.set(name, str);
+        });
+    };
+    add_environment("environment", false);
+    add_environment("path_environment", true);
+    return launcher;
+}
+
 void Toolchain::insert_tool(HashMap<String, Tool>& map, JsonObject tool_data, const String& filename)
 {
     tool_data.for_each_member([&](auto& key, auto& value) {
@@ -81,20 +218,20 @@ void Toolchain::insert_tool(HashMap<String, Tool>& map, JsonObject tool_data, co
             }
             if (key == "flags" || key == "test_flags") {
                 auto filepath = FileSystemPath(filename);
-                JsonArray values;
-
+                JsonArray single_value;
+                const JsonArray* values = &single_value;
                 if (value.is_string()) {
-                    values.append(value);
+                    single_value.append(value);
                 } else if (value.is_array()) {
-                    values = value.as_array();
+                    values = &value.as_array();
                 }
 
                 StringBuilder builder;
                 builder.append((key == "flags") ? tool.flags : tool.test_flags);
-                for (auto& value : values.values()) {
+                for (auto& value : values->values()) {
                     builder.append(" ");
 
-                    auto str = replace_variables(value.as_string(), "root", SettingsProvider::the().get_string("root").value_or(""));
+                    auto str = replace_variables(value.as_string(), "root", SettingsProvider::the().root().value_or(""));
                     str = replace_variables(str, "current_dir", filepath.dirname());
                     builder.append(replace_variables(str, "host_sysroot", "${CMAKE_SYSROOT}")); // FIXME: no cmake variables here... !
                 }
@@ -107,6 +244,11 @@ void Toolchain::insert_tool(HashMap<String, Tool>& map, JsonObject tool_data, co
                 return;
             }
 
+            if (key == "launcher") {
+                if (value.is_string() || value.is_object())
+                    tool.launcher = parse_launcher(value, filename);
+                return;
+            }
             if (key == "run_as_su") {
                 if (value.is_bool()) {
                     tool.run_as_su = value.as_bool();
@@ -2,11 +2,21 @@
 
 #include <AK/HashMap.h>
 #include <AK/JsonObject.h>
+#include <AK/Optional.h>
+
+class BinaryReader;
+class BinaryWriter;
 
 struct ToolConfiguration {
     String flags;
 };
 
+struct Launcher {
+    String executable;
+    // only passed to this launcher, path values are already absolute
+    HashMap<String, String> environment;
+};
+
 struct Tool {
     String executable;
     String flags;
@@ -15,13 +25,18 @@ struct Tool {
     bool add_as_target = false;
     bool reset_toolchain_flags = false;
     HashMap<String, String> execution_result_definitions;
+    // Replaces the launcher of the toolchain including its environment, an empty executable disables the launcher for this tool
+    Optional<Launcher> launcher;
 };
 
 class Toolchain {
 
 public:
-    Toolchain(const String&, const String&, JsonObject);
+    Toolchain(const String&, const String&, const JsonObject&);
+    // from the model cache
+    Toolchain(const String&, BinaryReader&);
     ~Toolchain();
+    void write(BinaryWriter&) const;
     bool add_file_tool_mapping(String file_extension, String tool);
     const String filename() const { return m_filename; }
     const HashMap<String, String>& file_tool_mapping() const { return m_file_tool_mapping; }
@@ -29,8 +44,14 @@ public:
     const HashMap<String, Tool>& target_tools() const { return m_target_tools; }
     const HashMap<String, Tool>& host_tools() const { return m_host_tools; }
     const HashMap<String, Tool>& build_tools() const { return m_build_tools; }
+    const Optional<Launcher>& launcher() const { return m_launcher; }
 
     static void insert_tool(HashMap<String, Tool>&, JsonObject, const String&);
+    static Launcher parse_launcher(const JsonValue&, const String&);
+    static void write_tools(BinaryWriter&, const HashMap<String, Tool>&);
+    static HashMap<String, Tool> read_tools(BinaryReader&);
+    static void write_launcher(BinaryWriter&, const Launcher&);
+    static Launcher read_launcher(BinaryReader&);
 
 private:
     String m_name;
@@ -40,4 +61,5 @@ private:
     HashMap<String, Tool> m_target_tools;
     HashMap<String, Tool> m_build_tools;
     HashMap<String, Tool> m_host_tools;
+    Optional<Launcher> m_launcher;
 };
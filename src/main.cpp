@@ -1,17 +1,27 @@
+#include "Arena.h"
+#include "BuildMonitor.h"
 #include "CMakeGenerator.h"
 #include "DependencyResolver.h"
 #include "FileProvider.h"
+#include "GlobCache.h"
+#include "HostResources.h"
 #include "ImageDB.h"
+#include "ModelCache.h"
 #include "PackageDB.h"
+#include "Profiler.h"
+#include "Server.h"
 #include "SettingsProvider.h"
+#include "Statistics.h"
+#include "TestRunner.h"
 #include "ToolchainDB.h"
 #include <AK/JsonValue.h>
 #include <AK/String.h>
 #include <AK/Types.h>
 #include <LibCore/File.h>
 #include <stdio.h>
-#include <sys/mman.h>
-#include <sys/wait.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 enum class PrimaryCommand : u8 {
     None = 0,
@@ -19,7 +29,9 @@ enum class PrimaryCommand : u8 {
     Generate,
     Config,
     Run,
-    Statistics
+    Serve,
+    Statistics,
+    Test
 };
 
 enum class ConfigSubCommand : u8 {
@@ -29,13 +41,9 @@ enum class ConfigSubCommand : u8 {
     List
 };
 
-bool has_generated(const String&)
+bool has_generated()
 {
-    // Fixme: This check is too simple. How can we check that a specific target (image or
-    //        package that is handed over via String parameter) has been generated already?
-    //        Maybe with some dotfiles?
-
-    String filename = SettingsProvider::the().get_string("gendata_directory").value_or("");
+    String filename = SettingsProvider::the().gendata_directory().value_or("");
 
     auto file = Core::File::construct();
     file->set_filename(filename);
@@ -49,6 +57,7 @@ Vector<String> s_loaded_settings_files;
 
 void load_meta_settings(Vector<String> files)
 {
+    ProfileScope scope("load settings");
     auto file = Core::File::construct();
     for (auto& filename : files) {
         file->set_filename(filename);
@@ -86,6 +95,7 @@ void load_meta_settings(Vector<String> files)
 
 void load_meta_all(Vector<String> files)
 {
+    ProfileScope scope("load meta json files");
     auto file = Core::File::construct();
     for (auto& filename : files) {
         file->set_filename(filename);
@@ -98,7 +108,11 @@ void load_meta_all(Vector<String> files)
             continue;
         }
 
-        auto json = JsonValue::from_string(file->read_all());
+        JsonValue json;
+        {
+            ProfileScope parse_scope("parse json", filename);
+            json = JsonValue::from_string(file->read_all());
+        }
 
         if (json.is_object()) {
             json.as_object().for_each_member([&](auto& key, auto& value) {
@@ -114,6 +128,7 @@ void load_meta_all(Vector<String> files)
 #ifdef DEBUG_META
                         fprintf(stderr, "Found package %s, adding to DB.\n", key.characters());
 #endif
+                        ProfileScope package_scope("add package", key);
                         bool result = add_package(key, filename, value.as_object());
                         if (!result) {
                             fprintf(stderr, "Could not add package to DB: Already existing\n");
@@ -131,9 +146,10 @@ void load_meta_all(Vector<String> files)
                             else if (key == "project")
                                 priority = SettingsPriority::Project;
 
-                            if (priority != SettingsPriority::Undefined)
+                            if (priority != SettingsPriority::Undefined) {
                                 SettingsProvider::the().add(filename, priority, value.as_object());
-                            else
+                                ModelCache::the().add_settings(filename, priority, value.as_object());
+                            } else
                                 fprintf(stderr, "Unknown settings priority %s found in JSON file.\n", key.characters());
                         });
                 } else if (key == "image") {
@@ -160,199 +176,195 @@ void load_meta_all(Vector<String> files)
     }
 }
 
-void statistics()
+// Loads a changed meta json file again for "meta serve" and replaces the packages it
+// defined. Returns false if the file defines more than packages, or a package that is
+// defined in another file as well, the server reloads the whole model then.
+bool reload_meta_json_file(const String& filename)
 {
-    auto& toolchains = ToolchainDB::the().entries();
-    StringBuilder toolchain_list;
-    u32 number_of_target_tools = 0;
-    u32 number_of_host_tools = 0;
-    u32 number_of_build_tools = 0;
-    u32 number_of_file_tool_mappings = 0;
-    ToolchainDB::the().for_each_entry([&](auto& name, auto& toolchain) {
-        toolchain_list.append(name);
-        toolchain_list.append(", ");
-        number_of_target_tools += toolchain.target_tools().size();
-        number_of_host_tools += toolchain.host_tools().size();
-        number_of_build_tools += toolchain.build_tools().size();
-        number_of_file_tool_mappings += toolchain.file_tool_mapping().size();
-        return IterationDecision::Continue;
+    // toolchains, images and settings are used by all packages
+    if (s_loaded_settings_files.contains_slow(filename) || ModelCache::the().has_settings(filename))
+        return false;
+    bool only_packages = true;
+    ToolchainDB::the().for_each_entry([&](auto&, auto& toolchain) {
+        only_packages = toolchain.filename() != filename;
+        return only_packages ? IterationDecision::Continue : IterationDecision::Break;
     });
+    ImageDB::the().for_each_entry([&](auto&, auto& image) {
+        only_packages = only_packages && image.filename() != filename;
+        return only_packages ? IterationDecision::Continue : IterationDecision::Break;
+    });
+    if (!only_packages)
+        return false;
 
-    StringBuilder package_list;
-    u32 number_of_source_files = 0;
-    u32 number_of_include_directories = 0;
-    u16 type_library = 0;
-    u16 type_executable = 0;
-    u16 type_collection = 0;
-    u16 type_deployment = 0;
-    u16 type_script = 0;
-    u16 type_undefined = 0;
-    u32 packages_count = 0;
-
-    auto package_iterator = [&](auto& name, auto& package) {
-        package_list.append(name);
-        package_list.append(", ");
-        number_of_source_files += package.sources().size();
-        number_of_include_directories += package.includes().size();
-        switch (package.type()) {
-        case PackageType::Library:
-            ++type_library;
-            break;
-        case PackageType::Executable:
-            ++type_executable;
-            break;
-        case PackageType::Collection:
-            ++type_collection;
-            break;
-        case PackageType::Deployment:
-            ++type_deployment;
-            break;
-        case PackageType::Script:
-            ++type_script;
-            break;
-        case PackageType::Undefined:
-            ++type_undefined;
-            break;
-        }
-        ++packages_count;
-
-        return IterationDecision::Continue;
-    };
+    auto file = Core::File::construct();
+    file->set_filename(filename);
+    if (!file->open(Core::IODevice::ReadOnly))
+        return false;
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.is_object())
+        return false;
+    json.as_object().for_each_member([&](auto& key, auto&) {
+        if (key != "package")
+            only_packages = false;
+    });
+    if (!only_packages)
+        return false;
 
-    BuildPackageDB::the().for_each_entry(package_iterator);
-    HostPackageDB::the().for_each_entry(package_iterator);
-    TargetPackageDB::the().for_each_entry(package_iterator);
+    ProfileScope scope("reload meta json file", filename);
+    DataBase<Package>* databases[] = { &BuildPackageDB::the(), &HostPackageDB::the(), &TargetPackageDB::the() };
+    for (auto* db : databases) {
+        db->thaw();
+        Vector<String> names;
+        db->for_each_entry([&](auto& name, auto& package) {
+            if (package.filename() == filename)
+                names.append(name);
+            return IterationDecision::Continue;
+        });
+        for (auto& name : names)
+            db->remove(name);
+    }
 
-    auto& images = ImageDB::the().entries();
-    StringBuilder image_list;
-    ImageDB::the().for_each_entry([&](auto& name, auto&) {
-        image_list.append(name);
-        image_list.append(", ");
-        return IterationDecision::Continue;
-    });
+    bool unique = true;
+    auto* packages = json.as_object().get_ptr("package");
+    if (packages && packages->is_object()) {
+        packages->as_object().for_each_member([&](auto& key, auto& value) {
+            for (auto* db : databases)
+                unique = unique && !db->get(key);
+            add_package(key, filename, value.as_object());
+        });
+    }
 
-    fprintf(stdout, "----- STATISTICS -----\n");
-    fprintf(stdout, "Toolchains: %lu\n", toolchains.size());
-    if (toolchains.size())
-        fprintf(stdout, "* %s\033[2D \n", toolchain_list.build().characters());
-    fprintf(stdout, "Build tools: %i\n", number_of_build_tools);
-    fprintf(stdout, "Host tools: %i\n", number_of_host_tools);
-    fprintf(stdout, "Target tools: %i\n", number_of_target_tools);
-    fprintf(stdout, "File extension tool mappings: %i\n", number_of_file_tool_mappings);
-    fprintf(stdout, "----- ---------- -----\n");
-    fprintf(stdout, "Packages: %i\n", packages_count);
-    if (packages_count)
-        fprintf(stdout, "* %s\033[2D \n", package_list.build().characters());
-    fprintf(stdout, "Packages with type Library: %i\n", type_library);
-    fprintf(stdout, "Packages with type Executable: %i\n", type_executable);
-    fprintf(stdout, "Packages with type Collection: %i\n", type_collection);
-    fprintf(stdout, "Packages with type Deployment: %i\n", type_deployment);
-    fprintf(stdout, "Packages with type Script: %i\n", type_script);
-    fprintf(stdout, "Packages with undefined type: %i\n", type_undefined);
-    fprintf(stdout, "Number of source files: %i\n", number_of_source_files);
-    fprintf(stdout, "Number of include directories: %i\n", number_of_include_directories);
-    fprintf(stdout, "----- ---------- -----\n");
-    fprintf(stdout, "Images: %lu\n", images.size());
-    if (images.size())
-        fprintf(stdout, "* %s\033[2D \n", image_list.build().characters());
-    fprintf(stdout, "----------------------\n");
+    DependencyResolver::the().probe_host_dependencies(BuildPackageDB::the());
+    DependencyResolver::the().probe_host_dependencies(HostPackageDB::the());
+    for (auto* db : databases)
+        db->freeze();
+    return unique;
 }
 
-bool run_command(const String& cmd, bool supress_output)
+// returns true if the command succeeded
+bool run_command(const String& cmd, bool supress_output, const String& report_filename = {})
 {
-    pid_t pid_status = fork();
+    BuildMonitor monitor(supress_output);
+    monitor.set_report_filename(report_filename);
+    return monitor.run(cmd) == 0;
+}
 
-    int fd = open("/tmp/meta-status", O_RDWR | O_CREAT | O_TRUNC, 0666);
-    if (fd < 0) {
-        perror("failed to open /tmp/meta-status");
-        ASSERT_NOT_REACHED();
-    }
-    size_t size = sizeof(bool);
-    if (ftruncate(fd, size) < 0) {
-        fprintf(stderr, "ftruncate() failed!\n");
-    }
+String configure_stamp(const String& gen_path, const String& configure_command)
+{
+    Vector<String> skip_names;
+    skip_names.append(".meta-glob-cache");
+    skip_names.append(".meta-model-cache");
+    skip_names.append(".meta-stamp");
+    skip_names.append(".meta-server.sock");
+    u64 hash = FileProvider::the().hash_tree(gen_path, skip_names);
 
-    bool* ptr = (bool*)mmap(nullptr, size, PROT_WRITE | PROT_READ, MAP_SHARED, fd, 0);
-    if (ptr == MAP_FAILED) {
-        fprintf(stderr, "mmap() failed!\n");
-    }
+    StringBuilder builder;
+    builder.appendf("%08x%08x %s\n", (u32)(hash >> 32), (u32)hash, configure_command.characters());
+    return builder.build();
+}
 
-    *ptr = false;
+bool is_configured(const String& build_path, const String& stamp_filename, const String& stamp)
+{
+    StringBuilder cmake_cache;
+    cmake_cache.append(build_path);
+    cmake_cache.append("/CMakeCache.txt");
 
-    if (pid_status == 0) {
-        fprintf(stdout, "\033[?25l");
-        char chars[4] = { '-', '\\', '|', '/' };
-        while (!*ptr) {
-            for (int i = 0; i < 4; ++i) {
-                fprintf(stdout, "\033[3D%c ", chars[i]);
-                usleep(1000);
-            }
-        }
-        // Fixme: do this also in a signalhandler which catches abnormal termination, otherwise the cursor might be lost...
-        fprintf(stdout, "\033[?25h");
-        exit(1);
-    }
+    auto file = Core::File::construct();
+    if (!file->exists(cmake_cache.build()))
+        return false;
 
-    pid_t pid_command = fork();
+    file->set_filename(stamp_filename);
+    if (!file->open(Core::IODevice::ReadOnly))
+        return false;
+    return String::copy(file->read_all()) == stamp;
+}
 
-    if (pid_command == 0) {
-        if (supress_output) {
-            int fd = open("/dev/null", O_WRONLY);
-            dup2(fd, 1);
-            dup2(fd, 2);
-        }
-        int rc = execl("/bin/sh", "sh", "-c", cmd.characters(), nullptr);
-        if (rc < 0)
-            perror("execl");
-        exit(1);
+void write_configure_stamp(const String& stamp_filename, const String& stamp)
+{
+    FILE* fd = fopen(stamp_filename.characters(), "w");
+    if (!fd) {
+        perror("fopen");
+        return;
     }
-
-    int status;
-    waitpid(pid_command, &status, 0);
-    *ptr = true;
-
-    int rc = munmap(ptr, size);
-    ASSERT(rc == 0);
-    UNUSED_PARAM(rc);
-
-    return WEXITSTATUS(status);
+    fputs(stamp.characters(), fd);
+    fclose(fd);
 }
 
 bool run_build_command(Vector<String> extra_targets, bool supress_output = false)
 {
     auto build_generator = SettingsProvider::the().get_string("build_generator").value_or("cmake");
-    auto gen_path = SettingsProvider::the().get_string("gendata_directory").value_or("");
-    auto build_path = SettingsProvider::the().get_string("build_directory").value_or("");
-    auto build_configuration = SettingsProvider::the().get("build_configuration");
+    auto gen_path = SettingsProvider::the().gendata_directory().value_or("");
+    auto build_path = SettingsProvider::the().build_directory().value_or("");
+    auto& build_configuration = SettingsProvider::the().build_configuration();
     String build_type = "debug";
     String build_tool = "make";
     u32 parallel_jobs = 0;
+    u32 memory_per_job = 1024;
+    u32 memory_per_link_job = 2048;
 
-    if (build_configuration.has_value()) {
-        if (build_configuration.value().is_json_object()) {
-            auto obj = build_configuration.value().as_json_object();
-            if (obj.get("type").is_string()) {
-                build_type = obj.get("type").as_string();
-            }
-            if (obj.get("tool").is_string()) {
-                build_tool = obj.get("tool").as_string();
-            }
-            if (obj.get("parallel_jobs").is_u32()) {
-                parallel_jobs = obj.get("parallel_jobs").as_u32();
-            }
-        }
+    if (build_configuration.get("type").is_string()) {
+        build_type = build_configuration.get("type").as_string();
+    }
+    if (build_configuration.get("tool").is_string()) {
+        build_tool = build_configuration.get("tool").as_string();
+    }
+    if (build_configuration.get("parallel_jobs").is_u32()) {
+        parallel_jobs = build_configuration.get("parallel_jobs").as_u32();
+    }
+    if (build_configuration.get("memory_per_job").is_u32()) {
+        memory_per_job = build_configuration.get("memory_per_job").as_u32();
+    }
+    if (build_configuration.get("memory_per_link_job").is_u32()) {
+        memory_per_link_job = build_configuration.get("memory_per_link_job").as_u32();
     }
 
-    StringBuilder builder;
-    builder.appendf("cd %s", build_path.characters());
+    // without configured parallel_jobs, use what the cores and the memory of the host allow
+    auto jobs = HostResources::automatic_jobs(memory_per_job, memory_per_link_job);
+    if (parallel_jobs) {
+        jobs.compile = parallel_jobs;
+        if (jobs.link > parallel_jobs)
+            jobs.link = parallel_jobs;
+    }
+
+    // the link and heavy job pools only exist for Ninja, make runs every job in the same -j slots
+    u32 build_jobs = jobs.compile;
+    if (!build_tool.ends_with("ninja")) {
+        if (!parallel_jobs)
+            build_jobs = jobs.link;
+        u32 memory_weight = TargetPackageDB::the().max_memory_weight();
+        memory_weight = max(memory_weight, HostPackageDB::the().max_memory_weight());
+        memory_weight = max(memory_weight, BuildPackageDB::the().max_memory_weight());
+        if (memory_weight > 1)
+            fprintf(stderr, "memory_weight %u is ignored by %s, only ninja limits the jobs of memory heavy packages.\n", memory_weight, build_tool.characters());
+    }
 
     if (build_generator == "cmake") {
-        builder.append(" && ");
-        builder.appendf("cmake %s -DCMAKE_BUILD_TYPE=%s", gen_path.characters(), build_type.characters());
+        StringBuilder configure_builder;
+        configure_builder.appendf("cmake %s -DCMAKE_BUILD_TYPE=%s", gen_path.characters(), build_type.characters());
+        configure_builder.appendf(" -DMETA_COMPILE_JOBS=%u -DMETA_LINK_JOBS=%u", jobs.compile, jobs.link);
+        auto configure_command = configure_builder.build();
+
+        // cmake re-runs itself when a CMakeLists.txt changes, but an explicit configure is
+        // only needed if the generated tree or the configure arguments differ
+        auto stamp = configure_stamp(gen_path, configure_command);
+        StringBuilder stamp_filename_builder;
+        stamp_filename_builder.append(build_path);
+        stamp_filename_builder.append("/.meta-configure-stamp");
+        auto stamp_filename = stamp_filename_builder.build();
+
+        if (!is_configured(build_path, stamp_filename, stamp)) {
+            StringBuilder configure;
+            configure.appendf("cd %s && %s", build_path.characters(), configure_command.characters());
+            ProfileScope configure_scope("cmake configure");
+            if (!run_command(configure.build(), supress_output))
+                return false;
+            write_configure_stamp(stamp_filename, stamp);
+        }
     }
-    builder.appendf(" && %s", build_tool.characters());
-    if (parallel_jobs)
-        builder.appendf(" -j%i ", parallel_jobs);
+
+    StringBuilder builder;
+    builder.appendf("cd %s", build_path.characters());
+    builder.appendf(" && %s -j%u ", build_tool.characters(), build_jobs);
 
     for (auto& target : extra_targets) {
         builder.appendf("%s ", target.characters());
@@ -365,14 +377,57 @@ bool run_build_command(Vector<String> extra_targets, bool supress_output = false
     fflush(stdout);
 #endif
 
-    return run_command(cmd, supress_output);
+    StringBuilder report_filename;
+    report_filename.append(build_path);
+    report_filename.append("/meta-build-times.txt");
+
+    ProfileScope build_scope("build tool");
+    return run_command(cmd, supress_output, report_filename.build());
 }
 
-int main(int argc, char** argv)
+// removes a global option from the argument list, so it can be given at any position
+bool take_option(int& argc, char** argv, const char* option)
+{
+    bool found = false;
+    for (int i = 1; i < argc;) {
+        if (!strcmp(argv[i], option)) {
+            for (int j = i; j < argc - 1; ++j)
+                argv[j] = argv[j + 1];
+            --argc;
+            found = true;
+        } else
+            ++i;
+    }
+    return found;
+}
+
+// same for an option followed by a value
+Optional<String> take_option_value(int& argc, char** argv, const char* option)
+{
+    Optional<String> value;
+    for (int i = 1; i < argc;) {
+        if (!strcmp(argv[i], option) && i + 1 < argc) {
+            value = String(argv[i + 1]);
+            for (int j = i; j < argc - 2; ++j)
+                argv[j] = argv[j + 2];
+            argc -= 2;
+        } else
+            ++i;
+    }
+    return value;
+}
+
+struct CommandLine {
+    PrimaryCommand cmd { PrimaryCommand::None };
+    ConfigSubCommand config_subcmd { ConfigSubCommand::None };
+};
+
+// prints the usage and returns false, if the arguments don't make up a command
+bool parse_command_line(int argc, char** argv, CommandLine& command_line)
 {
     int minarg = 2;
-    PrimaryCommand cmd = PrimaryCommand::None;
-    ConfigSubCommand config_subcmd = ConfigSubCommand::None;
+    PrimaryCommand& cmd = command_line.cmd;
+    ConfigSubCommand& config_subcmd = command_line.config_subcmd;
 
     if (argc >= minarg) {
         String arg1 { argv[1], strlen(argv[1]) };
@@ -408,6 +463,12 @@ int main(int argc, char** argv)
         } else if (arg1 == "run") {
             cmd = PrimaryCommand::Run;
             minarg = 2;
+        } else if (arg1 == "serve") {
+            cmd = PrimaryCommand::Serve;
+            minarg = 2;
+        } else if (arg1 == "test") {
+            cmd = PrimaryCommand::Test;
+            minarg = 2;
         }
     }
 
@@ -433,25 +494,348 @@ int main(int argc, char** argv)
             fprintf(stderr, "  Run:\n");
             fprintf(stderr, "    meta run [<image>]\n");
         }
+        if (cmd == PrimaryCommand::None || cmd == PrimaryCommand::Test) {
+            fprintf(stderr, "  Test:\n");
+            fprintf(stderr, "    meta test [<image>] [-j <jobs>] [--timeout <seconds>] [--shard <index>/<count>]\n");
+        }
+        if (cmd == PrimaryCommand::None) {
+            fprintf(stderr, "  Server:\n");
+            fprintf(stderr, "    meta serve\n");
+        }
         if (cmd == PrimaryCommand::None) {
             fprintf(stderr, "  Statistics:\n");
             fprintf(stderr, "    meta st\n");
             fprintf(stderr, "    meta stats\n");
+            fprintf(stderr, "    meta stats --json\n");
+            fprintf(stderr, "    (always loads the model itself, even while \"meta serve\" runs)\n");
+        }
+        if (cmd == PrimaryCommand::None) {
+            fprintf(stderr, "  Options:\n");
+            fprintf(stderr, "    --arena        use a bump allocator for the whole run (not for \"meta serve\")\n");
+            fprintf(stderr, "    --alloc-stats  print allocation counts and peak RSS\n");
+            fprintf(stderr, "    --no-glob-cache  expand all globs from the file system\n");
+            fprintf(stderr, "    --no-server    don't let a running \"meta serve\" execute the command\n");
+            fprintf(stderr, "    --only-stale   let \"meta gen\" regenerate only the parts whose inputs changed\n");
+            fprintf(stderr, "    --profile      print the time spent in every phase\n");
+            fprintf(stderr, "    --trace <file> write the phases as Chrome trace events\n");
+        }
+        return false;
+    }
+    return true;
+}
+
+int generate(int argc, char** argv, const Vector<String>& files)
+{
+#ifdef DEBUG_META
+    fprintf(stderr, "Generate!\n");
+#endif
+    auto configured_toolchain = SettingsProvider::the().toolchain();
+    auto toolchain = ToolchainDB::the().get(configured_toolchain.value_or("default"));
+    if (!toolchain) {
+        if (configured_toolchain.has_value()) {
+            fprintf(stderr, "Wrong toolchain configured: %s!\n", configured_toolchain.value().characters());
+            StringBuilder toolchain_list;
+            ToolchainDB::the().for_each_entry([&](auto& name, auto&) {
+                toolchain_list.append(name);
+                toolchain_list.append(", ");
+                return IterationDecision::Continue;
+            });
+            fprintf(stdout, "Available toolchains: %s\033[2D \n", toolchain_list.build().characters());
+        }
+    }
+
+    // TODO: For the toolchain it is essential that only the tools of the used toolchain are beeing checked.
+    // For example, tools for a different toolchain may be not available on your system. Thererfore, the
+    // Dependency resolver shall only check the tools of the used toolchain. Furthermore, it could also check
+    // only the dependencies of the selected package, or the packages contained in the selecte image.
+    // For now, all dependencies are checked, regardless if they must be built or not.
+    DependencyResolver::the().ensure_host_dependencies_probed();
+
+    bool isImage = false;
+    bool isPackage = false;
+    String parameter { argv[2], strlen(argv[2]) };
+
+    // check if given argument is an image or an package
+    ImageDB::the().for_each_entry([&](auto& name, auto&) {
+        if (name == parameter) {
+            isImage = true;
+            return IterationDecision::Break;
         }
+        return IterationDecision::Continue;
+    });
+
+    if (!isImage)
+        TargetPackageDB::the().for_each_entry([&](auto& name, auto&) {
+            if (name == parameter) {
+                isPackage = true;
+                return IterationDecision::Break;
+            }
+            return IterationDecision::Continue;
+        });
+
+    if (!isImage && !isPackage) {
+        fprintf(stderr, "No package or image name matching provided name: %s.\n", parameter.characters());
+        return -1;
+    }
+
+    Vector<String> missing_dependencies;
+
+    {
+        ProfileScope scope("resolve dependencies");
+        TargetPackageDB::the().for_each_entry([&](auto&, auto& package) {
+            auto node = DependencyResolver::the().get_dependency_tree(package);
+            auto& missing = DependencyResolver::the().missing_dependencies(node);
+            for (auto& dependency : missing)
+                missing_dependencies.append(dependency);
+
+            return IterationDecision::Continue;
+        });
+    }
+
+    if (missing_dependencies.size()) {
+        fprintf(stderr, "Could not resolve all dependencies. Missing dependencies:\n");
+        for (auto& dependency : missing_dependencies) {
+            fprintf(stderr, "* %s\n", dependency.characters());
+        }
+        return -1;
+    }
+
+    // TODO: Lookahead into the future, that would be nice to have plugins to load
+    // Find/load the generator plugin and execute it... for now, everything is static.
+    // auto buildGenerator = SettingsProvider::the().get("build_generator").value_or({ "internal", BuildGenerator::Undefined }).as_buildgenerator();
+    // GeneratorPluginsLoader::the().Initialize(buildGenerator); // Find all loadable plugins and initialize them
+    // GeneratorPluginsLoader::the().Generate(); // Generate everything
+
+    auto optBuildGenerator = SettingsProvider::the().get("build_generator");
+    if (optBuildGenerator.has_value()) {
+        auto buildGenerator = optBuildGenerator.value().as_buildgenerator();
+        switch (buildGenerator) {
+        case BuildGenerator::CMake: {
+            auto& cmakegen = CMakeGenerator::the();
+
+            ASSERT(toolchain);
+
+            if (isImage) {
+
+                Vector<const Package*> host_packages_in_order;
+                auto image = ImageDB::the().get(parameter);
+                ASSERT(image);
+                if (image->install_all()) {
+                    // all packages are installed, so the dependency order of the DB is the install order
+                    TargetPackageDB::the().for_each_entry_in_dependency_order([&](auto&, auto& package) {
+                        if (cmakegen.gen_package(package))
+                            host_packages_in_order.append(&package);
+                        return IterationDecision::Continue;
+                    });
+                } else {
+                    for (auto& package_name : image->install()) {
+                        const Package* package;
+                        if (!(package = TargetPackageDB::the().get(package_name))) {
+                            fprintf(stderr, "Image %s configured to install package %s. Package not found!", parameter.characters(), package_name.characters());
+                            return -1;
+                        }
+                        ASSERT(package);
+                        if (cmakegen.gen_package(*package)) {
+                            auto node = DependencyResolver::the().get_dependency_tree(*package);
+                            // add all packages, beginning from leave
+                            DependencyNode::start_by_leave(node, [&](auto& package) {
+                                bool found = false;
+                                for (auto& p : host_packages_in_order) {
+                                    if (p->name() == package.name()) {
+                                        found = true;
+                                        break;
+                                    }
+                                }
+
+                                if (!found)
+                                    host_packages_in_order.append(&package);
+                            });
+                        }
+                    }
+                }
+                fprintf(stdout, "Generate Image: %s!\n", image->name().characters());
+                cmakegen.gen_image(*image, host_packages_in_order);
+                cmakegen.gen_root(*toolchain, argc, argv);
+
+            } else if (isPackage) {
+                const Package* package = nullptr;
+                if (!(package = TargetPackageDB::the().get(parameter))) {
+                    fprintf(stderr, "Package %s not found!", parameter.characters());
+                    return -1;
+                }
+                ASSERT(package);
+                cmakegen.gen_package(*package);
+            }
+
+            cmakegen.gen_toolchain(*toolchain, files);
+            break;
+        }
+        default:
+            fprintf(stderr, "Invalid build configurator configured.");
+        }
+    } else {
+        fprintf(stderr, "Invalid build configurator configured.");
+    }
+
+    return 0;
+}
+
+// Regenerates the parts of the gendata directory the image or package needs, whose
+// generation stamps don't match their inputs anymore.
+bool update_generated(char* meta_binary, const String& parameter, const Vector<String>& files)
+{
+    if (parameter.is_empty()) {
+        if (has_generated())
+            return true;
+        fprintf(stderr, "Build system not yet generated. Please generate first by invoking \"meta gen <image>\" command.\n");
+        return false;
+    }
+
+    // the generated files re-run meta as "meta gen <target>" when a meta json file changes
+    char* gen_argv[] = { meta_binary, (char*)"gen", (char*)parameter.characters(), nullptr };
+
+    auto& cmakegen = CMakeGenerator::the();
+    cmakegen.set_only_stale(true);
+    if (generate(3, gen_argv, files) != 0)
+        return false;
+    if (cmakegen.generated_count())
+        fprintf(stdout, "Regenerated %u of %u parts of %s.\n", cmakegen.generated_count(),
+            cmakegen.generated_count() + cmakegen.up_to_date_count(), parameter.characters());
+    return true;
+}
+
+// "meta test [<image>] [-j <jobs>] [--timeout <seconds>] [--shard <index>/<count>]"
+bool run_tests(int argc, char** argv, const Vector<String>& files)
+{
+    String parameter;
+    u32 jobs = HostResources::usable_cpus();
+    u32 timeout_seconds = 300;
+    u32 shard_index = 1;
+    u32 shard_count = 1;
+    for (int i = 2; i < argc; ++i) {
+        bool has_value = i + 1 < argc;
+        if ((!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs")) && has_value) {
+            jobs = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--timeout") && has_value) {
+            timeout_seconds = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--shard") && has_value) {
+            if (sscanf(argv[++i], "%u/%u", &shard_index, &shard_count) != 2 || !shard_count || !shard_index || shard_index > shard_count) {
+                fprintf(stderr, "Invalid shard %s, expected <index>/<count> with 1 <= index <= count.\n", argv[i]);
+                return false;
+            }
+        } else if (argv[i][0] != '-' && parameter.is_empty()) {
+            parameter = argv[i];
+        } else {
+            fprintf(stderr, "Unknown test option: %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    // the tests are host executables, the target packages and the image are not needed
+    if (!update_generated(argv[0], parameter, files) || !run_build_command({ "HostToolchain" }, true))
+        return false;
+
+    TestRunner runner(SettingsProvider::the().build_directory().value_or(""), jobs, timeout_seconds);
+    runner.set_shard(shard_index, shard_count);
+    return runner.run();
+}
+
+// executes a command that needs the loaded model, returns the exit code
+int execute(const CommandLine& command_line, int argc, char** argv, const Vector<String>& files)
+{
+    int exit_code = 0;
+
+    if (command_line.cmd == PrimaryCommand::Generate)
+        exit_code = generate(argc, argv, files);
+
+    if (command_line.cmd == PrimaryCommand::Build) {
+        fprintf(stdout, "Build!\n");
+        String parameter { argv[2], strlen(argv[2]) };
+
+        if (!update_generated(argv[0], parameter, files) || !run_build_command({}, true))
+            exit_code = 1;
+    }
+
+    if (command_line.cmd == PrimaryCommand::Run) {
+        fprintf(stdout, "Run!\n");
+        String parameter { argc > 2 ? argv[2] : "" };
+
+        if (!update_generated(argv[0], parameter, files) || !run_build_command({ "build_image", "run" }))
+            exit_code = 1;
+    }
+
+    if (command_line.cmd == PrimaryCommand::Test) {
+        fprintf(stdout, "Test!\n");
+        if (!run_tests(argc, argv, files))
+            exit_code = 1;
+    }
+
+    if (command_line.cmd == PrimaryCommand::Statistics) {
+        bool as_json = false;
+        for (int i = 2; i < argc; ++i) {
+            if (!strcmp(argv[i], "--json"))
+                as_json = true;
+        }
+        // the unresolved dependencies don't count the ones the host provides
+        DependencyResolver::the().ensure_host_dependencies_probed();
+        Statistics::print(as_json);
+    }
+
+    return exit_code;
+}
+
+int main(int argc, char** argv)
+{
+    // "meta serve" re-executes itself with the original arguments to reload the model
+    Vector<char*> original_argv;
+    for (int i = 0; i < argc; ++i)
+        original_argv.append(argv[i]);
+    original_argv.append(nullptr);
+
+    bool alloc_stats = take_option(argc, argv, "--alloc-stats");
+    if (alloc_stats)
+        Arena::enable_statistics();
+    bool arena = take_option(argc, argv, "--arena");
+    if (take_option(argc, argv, "--no-glob-cache"))
+        GlobCache::the().disable();
+    bool no_server = take_option(argc, argv, "--no-server");
+    if (take_option(argc, argv, "--only-stale"))
+        CMakeGenerator::the().set_only_stale(true);
+    if (take_option(argc, argv, "--profile"))
+        Profiler::the().enable_summary();
+    auto trace_filename = take_option_value(argc, argv, "--trace");
+    if (trace_filename.has_value())
+        Profiler::the().enable_trace(trace_filename.value());
+
+    CommandLine command_line;
+    if (!parse_command_line(argc, argv, command_line))
         return 0;
+    if (arena) {
+        // the arena never frees, a server that reloads meta json files would only grow
+        if (command_line.cmd == PrimaryCommand::Serve) {
+            fprintf(stderr, "--arena can not be used with \"meta serve\".\n");
+            return 1;
+        }
+        Arena::enable();
     }
+    // the statistics include the time spent in the phases of the run
+    if (command_line.cmd == PrimaryCommand::Statistics)
+        Profiler::the().enable();
 
     SettingsProvider& settingsProvider = SettingsProvider::the();
 
     Vector<String> files;
     String root = FileProvider::the().current_dir();
-    FileProvider::the().for_each_parent_directory_including_current_dir([&](auto& directory) {
-        auto dir_files = FileProvider::the().glob("*.m.json", directory);
-        for (auto& file : dir_files) {
-            files.append(file);
-        }
-        return IterationDecision::Continue;
-    });
+    {
+        ProfileScope scope("find settings");
+        FileProvider::the().for_each_parent_directory_including_current_dir([&](auto& directory) {
+            auto dir_files = FileProvider::the().glob("*.m.json", directory);
+            for (auto& file : dir_files) {
+                files.append(file);
+            }
+            return IterationDecision::Continue;
+        });
+    }
 
 #ifdef DEBUG_META
     fprintf(stderr, "Searching for meta json files in: %s\n", root.characters());
@@ -465,8 +849,8 @@ int main(int argc, char** argv)
     // Settings, we likely know that we
     load_meta_settings(files);
 
-    if (cmd == PrimaryCommand::Config) {
-        switch (config_subcmd) {
+    if (command_line.cmd == PrimaryCommand::Config) {
+        switch (command_line.config_subcmd) {
         case ConfigSubCommand::Set: {
             break;
         }
@@ -494,204 +878,68 @@ int main(int argc, char** argv)
         return 0;
     }
 
-    files = FileProvider::the().glob_all_meta_json_files(SettingsProvider::the().get_string("root").value_or(root));
-    load_meta_all(files);
-
-    if (cmd == PrimaryCommand::Generate) {
-#ifdef DEBUG_META
-        fprintf(stderr, "Generate!\n");
-#endif
-        auto configured_toolchain = SettingsProvider::the().get_string("toolchain");
-        auto toolchain = ToolchainDB::the().get(configured_toolchain.value_or("default"));
-        if (!toolchain) {
-            if (configured_toolchain.has_value()) {
-                fprintf(stderr, "Wrong toolchain configured: %s!\n", configured_toolchain.value().characters());
-                StringBuilder toolchain_list;
-                ToolchainDB::the().for_each_entry([&](auto& name, auto&) {
-                    toolchain_list.append(name);
-                    toolchain_list.append(", ");
-                    return IterationDecision::Continue;
-                });
-                fprintf(stdout, "Available toolchains: %s\033[2D \n", toolchain_list.build().characters());
-            }
-        }
-
-        // TODO: For the toolchain it is essential that only the tools of the used toolchain are beeing checked.
-        // For example, tools for a different toolchain may be not available on your system. Thererfore, the
-        // Dependency resolver shall only check the tools of the used toolchain. Furthermore, it could also check
-        // only the dependencies of the selected package, or the packages contained in the selecte image.
-        // For now, all dependencies are checked, regardless if they must be built or not.
-
-        bool isImage = false;
-        bool isPackage = false;
-        String parameter { argv[2], strlen(argv[2]) };
-
-        // check if given argument is an image or an package
-        ImageDB::the().for_each_entry([&](auto& name, auto&) {
-            if (name == parameter) {
-                isImage = true;
-                return IterationDecision::Break;
-            }
-            return IterationDecision::Continue;
-        });
-
-        if (!isImage)
-            TargetPackageDB::the().for_each_entry([&](auto& name, auto&) {
-                if (name == parameter) {
-                    isPackage = true;
-                    return IterationDecision::Break;
-                }
-                return IterationDecision::Continue;
-            });
-
-        if (!isImage && !isPackage) {
-            fprintf(stderr, "No package or image name matching provided name: %s.\n", parameter.characters());
-            return -1;
-        }
-
-        Vector<String> missing_dependencies;
-
-        TargetPackageDB::the().for_each_entry([&](auto&, auto& package) {
-            auto node = DependencyResolver::the().get_dependency_tree(package);
-            auto& missing = DependencyResolver::the().missing_dependencies(node);
-            for (auto& dependency : missing)
-                missing_dependencies.append(dependency);
-
-            return IterationDecision::Continue;
-        });
-
-        if (missing_dependencies.size()) {
-            fprintf(stderr, "Could not resolve all dependencies. Missing dependencies:\n");
-            for (auto& dependency : missing_dependencies) {
-                fprintf(stderr, "* %s\n", dependency.characters());
-            }
-            return -1;
-        }
-
-        // TODO: Lookahead into the future, that would be nice to have plugins to load
-        // Find/load the generator plugin and execute it... for now, everything is static.
-        // auto buildGenerator = settingsProvider.get("build_generator").value_or({ "internal", BuildGenerator::Undefined }).as_buildgenerator();
-        // GeneratorPluginsLoader::the().Initialize(buildGenerator); // Find all loadable plugins and initialize them
-        // GeneratorPluginsLoader::the().Generate(); // Generate everything
-
-        auto optBuildGenerator = settingsProvider.get("build_generator");
-        if (optBuildGenerator.has_value()) {
-            auto buildGenerator = optBuildGenerator.value().as_buildgenerator();
-            switch (buildGenerator) {
-            case BuildGenerator::CMake: {
-                auto& cmakegen = CMakeGenerator::the();
-
-                ASSERT(toolchain);
-
-                if (isImage) {
-
-                    Vector<const Package*> host_packages_in_order;
-                    auto image = ImageDB::the().get(parameter);
-                    ASSERT(image);
-                    if (image->install_all()) {
-                        TargetPackageDB::the().for_each_entry([&](auto&, auto& data) {
-                            if (cmakegen.gen_package(data)) {
-                                auto node = DependencyResolver::the().get_dependency_tree(data);
-#ifdef DEBUG_META
-                                fprintf(stderr, "Resolving dependency tree for package: %s\n", data.name().characters());
-#endif
-                                // add all packages, beginning from leave
-                                DependencyNode::start_by_leave(node, [&](auto& package) {
-                                    bool found = false;
-                                    for (auto& p : host_packages_in_order) {
-                                        if (p->name() == package.name()) {
-                                            found = true;
-#ifdef DEBUG_META
-                                            fprintf(stderr, " -> Found dep: %s\n", package.name().characters());
-#endif
-                                            break;
-                                        }
-                                    }
-
-                                    if (!found) {
-                                        host_packages_in_order.append(&package);
-#ifdef DEBUG_META
-                                        fprintf(stderr, " --> Adding dep: %s\n", package.name().characters());
-#endif
-                                    }
-                                });
-                            }
-                            return IterationDecision::Continue;
-                        });
-                    } else {
-                        for (auto& package_name : image->install()) {
-                            const Package* package;
-                            if (!(package = TargetPackageDB::the().get(package_name))) {
-                                fprintf(stderr, "Image %s configured to install package %s. Package not found!", parameter.characters(), package_name.characters());
-                                return -1;
-                            }
-                            ASSERT(package);
-                            if (cmakegen.gen_package(*package)) {
-                                auto node = DependencyResolver::the().get_dependency_tree(*package);
-                                // add all packages, beginning from leave
-                                DependencyNode::start_by_leave(node, [&](auto& package) {
-                                    bool found = false;
-                                    for (auto& p : host_packages_in_order) {
-                                        if (p->name() == package.name()) {
-                                            found = true;
-                                            break;
-                                        }
-                                    }
-
-                                    if (!found)
-                                        host_packages_in_order.append(&package);
-                                });
-                            }
-                        }
-                    }
-                    fprintf(stdout, "Generate Image: %s!\n", image->name().characters());
-                    cmakegen.gen_image(*image, host_packages_in_order);
-                    cmakegen.gen_root(*toolchain, argc, argv);
-
-                } else if (isPackage) {
-                    const Package* package = nullptr;
-                    if (!(package = TargetPackageDB::the().get(parameter))) {
-                        fprintf(stderr, "Package %s not found!", parameter.characters());
-                        return -1;
-                    }
-                    ASSERT(package);
-                    cmakegen.gen_package(*package);
-                }
-
-                cmakegen.gen_toolchain(*toolchain, files);
-                break;
-            }
-            default:
-                fprintf(stderr, "Invalid build configurator configured.");
-            }
-        } else {
-            fprintf(stderr, "Invalid build configurator configured.");
-        }
+    // profiling and the statistics measure this process including loading, so they don't hand the command to the server
+    bool measures_loading = alloc_stats || Profiler::the().is_enabled() || command_line.cmd == PrimaryCommand::Statistics;
+    if (!no_server && !measures_loading && command_line.cmd != PrimaryCommand::Serve) {
+        auto exit_code = Server::forward(argc, argv);
+        if (exit_code.has_value())
+            return exit_code.value();
     }
 
-    if (cmd == PrimaryCommand::Build) {
-        fprintf(stdout, "Build!\n");
-        String parameter { argv[2], strlen(argv[2]) };
+    struct timespec load_start;
+    clock_gettime(CLOCK_REALTIME, &load_start);
+
+    auto gendata_directory = SettingsProvider::the().gendata_directory().value_or("");
+    GlobCache::the().load(gendata_directory);
+    // the settings files found from the current directory are inputs of the model as well
+    auto settings_files = files;
+    files = FileProvider::the().glob_all_meta_json_files(SettingsProvider::the().root().value_or(root));
+    auto model_files = settings_files;
+    model_files.append(files.data(), files.size());
+    if (!ModelCache::the().load(gendata_directory, model_files)) {
+        load_meta_all(files);
+        // the snapshot is taken before probing, it must not depend on the host
+        ModelCache::the().save(gendata_directory, model_files);
+    }
 
-        if (has_generated(parameter))
-            run_build_command({}, true);
-        else
-            fprintf(stderr, "Build system not yet generated. Please generate first by invoking \"meta gen %s\" command.", parameter.characters());
+    // loading is done, from now on all DBs are read-only
+    {
+        ProfileScope scope("freeze databases");
+        BuildPackageDB::the().freeze();
+        HostPackageDB::the().freeze();
+        TargetPackageDB::the().freeze();
+        ImageDB::the().freeze();
+        ToolchainDB::the().freeze();
+    }
+    GlobCache::the().save();
+
+    if (alloc_stats)
+        Arena::dump_statistics("meta (loaded)");
+
+    if (command_line.cmd == PrimaryCommand::Serve) {
+        // every client command runs in a child process, probe once for all of them
+        DependencyResolver::the().ensure_host_dependencies_probed();
+        auto execute_client_command = [&](int argc, char** argv) {
+            CommandLine client_command_line;
+            if (!parse_command_line(argc, argv, client_command_line))
+                return 1;
+            return execute(client_command_line, argc, argv, files);
+        };
+        return Server::serve(original_argv.data(), files, load_start, execute_client_command, reload_meta_json_file);
     }
 
-    if (cmd == PrimaryCommand::Run) {
-        fprintf(stdout, "Run!\n");
-        String parameter { argv[2], strlen(argv[2]) };
+    int exit_code = execute(command_line, argc, argv, files);
+    Profiler::the().report();
 
-        if (has_generated(parameter))
-            run_build_command({ "build_image", "run" });
-        else
-            fprintf(stderr, "Build system not yet generated. Please generate first by invoking \"meta gen %s\" command.", parameter.characters());
-    }
+    if (alloc_stats)
+        Arena::dump_statistics("meta (total)");
 
-    if (cmd == PrimaryCommand::Statistics) {
-        statistics();
+    if (Arena::is_enabled()) {
+        // the arena is released as a whole, skip the destructors of all databases
+        fflush(stdout);
+        fflush(stderr);
+        _exit(exit_code);
     }
 
-    return 0;
+    return exit_code;
 }